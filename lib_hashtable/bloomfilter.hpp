@@ -0,0 +1,178 @@
+#pragma once
+#include "err.hpp"
+#include "mixhash.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace lib_hashtable {
+// A single cache line worth of filter bits. Every key maps to exactly one
+// block and sets one bit in each of its 8 words, so a lookup costs one cache
+// miss no matter how many bits we probe.
+struct alignas(64) BloomFilterBlock
+{
+  uint64_t words[8];
+};
+
+// BloomFilter is a blocked ("split block") Bloom filter. It answers "is this
+// hash definitely absent?" cheaply so callers can skip expensive lookups.
+//
+// It works on already-computed 64-bit hashes and never stores keys. It can't
+// remove entries either: owners that remove keys should call clear() and
+// re-add the remaining ones once enough stale bits pile up (see
+// needs_rebuild()).
+class BloomFilter
+{
+private:
+  // Odd constants used to derive 8 independent bit positions from one hash.
+  // Same idea (and values) as the split block Bloom filter used by Parquet
+  // and Impala.
+  static constexpr uint32_t s_salts[8] = { 0x47b6137bU, 0x44974d91U,
+                                           0x8824ad5bU, 0xa2b7289dU,
+                                           0x705495c7U, 0x2df1424bU,
+                                           0x9efc4947U, 0x5c6bfb31U };
+  static constexpr size_t s_block_bits = sizeof(BloomFilterBlock) * 8;
+
+  BloomFilterBlock* m_blocks;
+  size_t m_num_blocks;
+  // Number of hashes added since the last clear()
+  size_t m_num_added{ 0 };
+  // Number of hashes that were removed by the owner but whose bits are still
+  // set in the filter
+  size_t m_num_stale{ 0 };
+
+  auto block_for(uint64_t hash) const -> BloomFilterBlock&
+  {
+    // Use the upper half for the block index and the lower half for the bit
+    // positions, so both are independent of each other
+    return m_blocks[((hash >> 32) * m_num_blocks) >> 32];
+  }
+
+  // Fill "out_mask" with the bit to set/check in each of the block's words.
+  // This is a fixed-size, branch-free loop so the compiler can vectorize it.
+  static void make_mask(uint64_t hash, uint64_t (&out_mask)[8])
+  {
+    const auto lower = static_cast<uint32_t>(hash);
+    for (size_t i = 0; i < 8; i++) {
+      out_mask[i] = uint64_t{ 1 } << ((lower * s_salts[i]) >> 26);
+    }
+  }
+
+public:
+  BloomFilter()
+    : m_blocks(nullptr)
+    , m_num_blocks(0)
+  {}
+  ~BloomFilter()
+  {
+    delete[] m_blocks;
+    m_blocks = nullptr;
+  }
+  BloomFilter(const BloomFilter&) = delete;
+  auto operator=(const BloomFilter&) -> BloomFilter& = delete;
+
+  // init allocates enough blocks to hold "expected_keys" keys at
+  // "bits_per_key" bits each. Roughly, 8 bits per key gives a ~2.5% false
+  // positive rate, 16 gives ~0.1%.
+  auto init(size_t expected_keys, size_t bits_per_key) -> err_t
+  {
+    if (bits_per_key == 0) {
+      return BLOOMFILTER_ERR_BAD;
+    }
+    size_t num_blocks =
+      (expected_keys * bits_per_key + s_block_bits - 1) / s_block_bits;
+    if (num_blocks == 0) {
+      num_blocks = 1;
+    }
+    auto* blocks = new (std::nothrow) BloomFilterBlock[num_blocks]();
+    if (!blocks) {
+      return ERR_NO_MEMORY;
+    }
+    delete[] m_blocks;
+    m_blocks = blocks;
+    m_num_blocks = num_blocks;
+    m_num_added = 0;
+    m_num_stale = 0;
+    return ERR_OK;
+  }
+
+  // copy_from makes this filter an exact copy of "other"
+  auto copy_from(const BloomFilter& other) -> err_t
+  {
+    auto* blocks = new (std::nothrow) BloomFilterBlock[other.m_num_blocks];
+    if (!blocks) {
+      return ERR_NO_MEMORY;
+    }
+    for (size_t i = 0; i < other.m_num_blocks; i++) {
+      blocks[i] = other.m_blocks[i];
+    }
+    delete[] m_blocks;
+    m_blocks = blocks;
+    m_num_blocks = other.m_num_blocks;
+    m_num_added = other.m_num_added;
+    m_num_stale = other.m_num_stale;
+    return ERR_OK;
+  }
+
+  auto num_blocks() -> size_t { return m_num_blocks; }
+  auto size_in_bytes() -> size_t
+  {
+    return m_num_blocks * sizeof(BloomFilterBlock);
+  }
+  auto num_added() -> size_t { return m_num_added; }
+  auto num_stale() -> size_t { return m_num_stale; }
+
+  void add(uint64_t hash)
+  {
+    hash = mix_hash(hash);
+    uint64_t mask[8];
+    make_mask(hash, mask);
+    auto& block = block_for(hash);
+    for (size_t i = 0; i < 8; i++) {
+      block.words[i] |= mask[i];
+    }
+    m_num_added++;
+  }
+
+  // may_contain returns false if "hash" was definitely never added, and true
+  // if it might have been
+  auto may_contain(uint64_t hash) const -> bool
+  {
+    hash = mix_hash(hash);
+    uint64_t mask[8];
+    make_mask(hash, mask);
+    const auto& block = block_for(hash);
+    // No early exit: checking all 8 words at once is cheaper than branching
+    uint64_t missing = 0;
+    for (size_t i = 0; i < 8; i++) {
+      missing |= mask[i] & ~block.words[i];
+    }
+    return missing == 0;
+  }
+
+  // mark_stale tells the filter one of the added hashes is gone. The bits
+  // stay set (we can't know which other keys share them), they just count
+  // towards needs_rebuild()
+  void mark_stale() { m_num_stale++; }
+
+  // needs_rebuild returns true once at least half of the added hashes were
+  // removed. Rebuilding usually costs more than re-adding the live hashes
+  // (e.g. a hash table has to walk all of its buckets), so owners pass that
+  // cost as "rebuild_cost": we also wait for half of it in removes, which
+  // keeps the amortized rebuild cost per remove constant
+  auto needs_rebuild(size_t rebuild_cost = 0) -> bool
+  {
+    const size_t cost = m_num_added > rebuild_cost ? m_num_added : rebuild_cost;
+    return m_num_stale > 0 && m_num_stale * 2 >= cost;
+  }
+
+  void clear()
+  {
+    for (size_t i = 0; i < m_num_blocks; i++) {
+      m_blocks[i] = BloomFilterBlock();
+    }
+    m_num_added = 0;
+    m_num_stale = 0;
+  }
+};
+} // namespace
@@ -0,0 +1,643 @@
+#pragma once
+#include "changelogcodec.hpp"
+#include "err.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+#include <utility>
+
+namespace lib_hashtable {
+struct ChangeLogOptions
+{
+  // The flusher waits up to this long for more records to join a batch
+  // before writing and fsync-ing it...
+  std::chrono::milliseconds max_commit_latency{ 10 };
+  // ...unless this many bytes are already waiting
+  size_t max_commit_bytes{ 64 * 1024 };
+};
+
+// ChangeLog is an append-only write-ahead log of put()/remove() calls.
+//
+// append_put() and append_remove() only encode the record into an in-memory
+// buffer. A background thread writes the buffer out and fsyncs it in batches
+// (group commit), so writers don't wait for the disk. Call sync() when you
+// need everything appended so far to be durable.
+//
+// Files live next to "path":
+//    <path>.log.<N>    log segments, replayed in order
+//    <path>.snapshot   every element as of the start of segment N
+//
+// compact() writes a snapshot of a table in another background thread and
+// deletes the segments it covers. replay() loads the snapshot and the
+// segments after it back into a table.
+template<typename K, typename V>
+class ChangeLog
+{
+  static_assert(ChangeLogCodec<K>::supported && ChangeLogCodec<V>::supported,
+                "K and V need a ChangeLogCodec specialization");
+
+private:
+  // Every record looks like this:
+  //    [u8 type][u32 key size][u32 value size][key][value][u32 checksum]
+  // remove records have an empty value, clear records an empty key too. The
+  // checksum covers everything before it, so a record torn by a crash is
+  // detected on replay.
+  enum : uint8_t
+  {
+    RECORD_PUT = 1,
+    RECORD_REMOVE = 2,
+    RECORD_CLEAR = 3,
+  };
+  static constexpr size_t s_record_header_size = 1 + 4 + 4;
+  static constexpr size_t s_record_checksum_size = 4;
+  static constexpr char s_snapshot_magic[8] = { 'L', 'H', 'T', 'S',
+                                                'N', 'A', 'P', '1' };
+
+  std::string m_path;
+  ChangeLogOptions m_options;
+
+  // Everything below is guarded by m_mutex
+  std::mutex m_mutex;
+  std::condition_variable m_flusher_cv;
+  std::condition_variable m_durable_cv;
+  // Records waiting to be written to segment m_segment
+  std::string m_buffer;
+  // Records waiting to be written to the segment before m_segment. compact()
+  // fills this when it starts a new segment
+  std::string m_sealed_buffer;
+  bool m_has_sealed_buffer{ false };
+  uint64_t m_segment{ 0 };
+  // Number of records appended so far, and how many of those are durable
+  uint64_t m_num_appended{ 0 };
+  uint64_t m_num_durable{ 0 };
+  size_t m_num_sync_waiters{ 0 };
+  bool m_is_open{ false };
+  bool m_stop{ false };
+  // Sticky: once writing fails, every later call returns the error
+  err_t m_err{ ERR_OK };
+
+  // Only touched by the flusher thread (and open()/close() when it isn't
+  // running)
+  int m_fd{ -1 };
+  std::thread m_flusher_thread;
+
+  // Oldest segment that may still exist on disk
+  uint64_t m_first_segment{ 0 };
+  std::thread m_compaction_thread;
+  std::atomic<bool> m_is_compacting{ false };
+  std::atomic<err_t> m_compaction_err{ ERR_OK };
+
+  static auto segment_path(const std::string& path, uint64_t segment)
+    -> std::string
+  {
+    return path + ".log." + std::to_string(segment);
+  }
+  static auto snapshot_path(const std::string& path) -> std::string
+  {
+    return path + ".snapshot";
+  }
+
+  static auto file_exists(const std::string& path) -> bool
+  {
+    return ::access(path.c_str(), F_OK) == 0;
+  }
+
+  // FNV-1a
+  static auto checksum(const char* data, size_t size) -> uint32_t
+  {
+    uint32_t hash = 2166136261U;
+    for (size_t i = 0; i < size; i++) {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 16777619U;
+    }
+    return hash;
+  }
+
+  static void append_u32(std::string& out, uint32_t value)
+  {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  static auto read_u32(const char* data) -> uint32_t
+  {
+    uint32_t value = 0;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  static void encode_record(std::string& out,
+                            uint8_t type,
+                            const K* key,
+                            const V* value)
+  {
+    const size_t start = out.size();
+    out.push_back(static_cast<char>(type));
+    // Sizes are patched in once we know them
+    out.append(8, '\0');
+    if (key) {
+      ChangeLogCodec<K>::encode(*key, out);
+    }
+    const size_t key_size = out.size() - start - s_record_header_size;
+    if (value) {
+      ChangeLogCodec<V>::encode(*value, out);
+    }
+    const size_t value_size =
+      out.size() - start - s_record_header_size - key_size;
+    const auto key_size32 = static_cast<uint32_t>(key_size);
+    const auto value_size32 = static_cast<uint32_t>(value_size);
+    std::memcpy(&out[start + 1], &key_size32, 4);
+    std::memcpy(&out[start + 5], &value_size32, 4);
+    append_u32(out, checksum(&out[start], out.size() - start));
+  }
+
+  // apply_records decodes records from "data" and applies them to "table".
+  // It stops quietly at the first incomplete or corrupt record, since that's
+  // what a crash in the middle of a write leaves behind.
+  template<typename Table>
+  static auto apply_records(const std::string& data, Table& table) -> err_t
+  {
+    size_t offset = 0;
+    while (data.size() - offset >=
+           s_record_header_size + s_record_checksum_size) {
+      const char* record = data.data() + offset;
+      const auto type = static_cast<uint8_t>(record[0]);
+      const size_t key_size = read_u32(record + 1);
+      const size_t value_size = read_u32(record + 5);
+      const size_t record_size = s_record_header_size + key_size +
+                                 value_size + s_record_checksum_size;
+      if (data.size() - offset < record_size) {
+        break;
+      }
+      const size_t checksum_offset = record_size - s_record_checksum_size;
+      if (read_u32(record + checksum_offset) !=
+          checksum(record, checksum_offset)) {
+        break;
+      }
+      offset += record_size;
+
+      if (type == RECORD_CLEAR) {
+        auto err = table.clear();
+        if (err != ERR_OK) {
+          return err;
+        }
+        continue;
+      }
+      K key;
+      if (!ChangeLogCodec<K>::decode(
+            record + s_record_header_size, key_size, key)) {
+        return CHANGELOG_ERR_BAD;
+      }
+      err_t err = ERR_OK;
+      if (type == RECORD_PUT) {
+        V value;
+        if (!ChangeLogCodec<V>::decode(record + s_record_header_size +
+                                         key_size,
+                                       value_size,
+                                       value)) {
+          return CHANGELOG_ERR_BAD;
+        }
+        err = table.put(key, value);
+      } else if (type == RECORD_REMOVE) {
+        err = table.remove(key);
+        // The key may have been removed by a previous segment already
+        if (err == HASHTABLE_ERR_ELEMENT_NOT_FOUND) {
+          err = ERR_OK;
+        }
+      } else {
+        return CHANGELOG_ERR_BAD;
+      }
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    return ERR_OK;
+  }
+
+  static auto read_file(const std::string& path, std::string& out_data)
+    -> err_t
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return CHANGELOG_ERR_IO;
+    }
+    out_data.clear();
+    char chunk[64 * 1024];
+    while (true) {
+      ssize_t n = ::read(fd, chunk, sizeof(chunk));
+      if (n < 0) {
+        ::close(fd);
+        return CHANGELOG_ERR_IO;
+      }
+      if (n == 0) {
+        break;
+      }
+      out_data.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return ERR_OK;
+  }
+
+  static auto write_all(int fd, const std::string& data) -> err_t
+  {
+    size_t offset = 0;
+    while (offset < data.size()) {
+      ssize_t n = ::write(fd, data.data() + offset, data.size() - offset);
+      if (n < 0) {
+        return CHANGELOG_ERR_IO;
+      }
+      offset += static_cast<size_t>(n);
+    }
+    return ERR_OK;
+  }
+
+  // fsync_parent_dir makes sure a file we just created or renamed is still
+  // there after a crash
+  static auto fsync_parent_dir(const std::string& path) -> err_t
+  {
+    const size_t slash = path.rfind('/');
+    const std::string dir =
+      slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return CHANGELOG_ERR_IO;
+    }
+    int ret = ::fsync(fd);
+    ::close(fd);
+    return ret == 0 ? ERR_OK : CHANGELOG_ERR_IO;
+  }
+
+  // open_segment creates segment "segment" and opens it for appending. "fd"
+  // is -1 if it fails
+  static auto open_segment(const std::string& path, uint64_t segment, int& fd)
+    -> err_t
+  {
+    const auto new_segment_path = segment_path(path, segment);
+    fd = ::open(new_segment_path.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC | O_APPEND,
+                0644);
+    if (fd < 0) {
+      return CHANGELOG_ERR_IO;
+    }
+    auto err = fsync_parent_dir(new_segment_path);
+    if (err != ERR_OK) {
+      ::close(fd);
+      fd = -1;
+    }
+    return err;
+  }
+
+  // read_snapshot_segment returns the first segment that isn't covered by the
+  // snapshot at "path", or 0 if there is no snapshot
+  static auto read_snapshot_segment(const std::string& path,
+                                    std::string& out_data,
+                                    uint64_t& out_segment) -> err_t
+  {
+    out_segment = 0;
+    out_data.clear();
+    if (!file_exists(snapshot_path(path))) {
+      return ERR_OK;
+    }
+    auto err = read_file(snapshot_path(path), out_data);
+    if (err != ERR_OK) {
+      return err;
+    }
+    // Snapshots are only renamed into place once they're complete, so a bad
+    // header means something else went wrong
+    if (out_data.size() < sizeof(s_snapshot_magic) + sizeof(uint64_t) ||
+        std::memcmp(
+          out_data.data(), s_snapshot_magic, sizeof(s_snapshot_magic)) != 0) {
+      return CHANGELOG_ERR_BAD;
+    }
+    std::memcpy(&out_segment,
+                out_data.data() + sizeof(s_snapshot_magic),
+                sizeof(out_segment));
+    return ERR_OK;
+  }
+
+  void run_flusher()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+      m_flusher_cv.wait(lock, [this] {
+        return m_stop || !m_buffer.empty() || m_has_sealed_buffer;
+      });
+      // Group commit: give other writers a chance to join this batch
+      m_flusher_cv.wait_for(lock, m_options.max_commit_latency, [this] {
+        return m_stop || m_has_sealed_buffer || m_num_sync_waiters > 0 ||
+               m_buffer.size() >= m_options.max_commit_bytes;
+      });
+      if (m_buffer.empty() && !m_has_sealed_buffer) {
+        if (m_stop) {
+          break;
+        }
+        continue;
+      }
+
+      std::string buffer;
+      std::string sealed_buffer;
+      buffer.swap(m_buffer);
+      sealed_buffer.swap(m_sealed_buffer);
+      const bool has_sealed_buffer = m_has_sealed_buffer;
+      m_has_sealed_buffer = false;
+      const uint64_t segment = m_segment;
+      const uint64_t num_appended = m_num_appended;
+      const bool had_err = m_err != ERR_OK;
+      lock.unlock();
+
+      // Don't hold the lock while touching the disk, so writers can keep
+      // appending to m_buffer
+      err_t err = ERR_OK;
+      if (!had_err && has_sealed_buffer) {
+        // Finish off the previous segment and move on to the next one
+        err = write_all(m_fd, sealed_buffer);
+        if (err == ERR_OK && ::fsync(m_fd) != 0) {
+          err = CHANGELOG_ERR_IO;
+        }
+        ::close(m_fd);
+        m_fd = -1;
+        if (err == ERR_OK) {
+          err = open_segment(m_path, segment, m_fd);
+        }
+      }
+      if (!had_err && err == ERR_OK) {
+        err = write_all(m_fd, buffer);
+        if (err == ERR_OK && ::fsync(m_fd) != 0) {
+          err = CHANGELOG_ERR_IO;
+        }
+      }
+
+      lock.lock();
+      if (err != ERR_OK) {
+        m_err = err;
+      } else if (!had_err) {
+        m_num_durable = num_appended;
+      }
+      m_durable_cv.notify_all();
+    }
+  }
+
+  void join_compaction_thread()
+  {
+    if (m_compaction_thread.joinable()) {
+      m_compaction_thread.join();
+    }
+  }
+
+  // run_compaction writes "snapshot" (already encoded) next to the log, and
+  // deletes the segments it covers. Runs in m_compaction_thread.
+  void run_compaction(std::string snapshot, uint64_t first_segment)
+  {
+    const auto tmp_path = snapshot_path(m_path) + ".tmp";
+    err_t err = ERR_OK;
+    int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      err = CHANGELOG_ERR_IO;
+    }
+    if (err == ERR_OK) {
+      err = write_all(fd, snapshot);
+      if (err == ERR_OK && ::fsync(fd) != 0) {
+        err = CHANGELOG_ERR_IO;
+      }
+      ::close(fd);
+    }
+    // rename() is atomic, so replay() sees either the old snapshot or the new
+    // one
+    if (err == ERR_OK &&
+        ::rename(tmp_path.c_str(), snapshot_path(m_path).c_str()) != 0) {
+      err = CHANGELOG_ERR_IO;
+    }
+    if (err == ERR_OK) {
+      err = fsync_parent_dir(m_path);
+    }
+    if (err == ERR_OK) {
+      // Everything before "first_segment" is in the snapshot now. It's fine
+      // if the flusher still has one of these open: unlinking doesn't affect
+      // it
+      for (uint64_t segment = m_first_segment; segment < first_segment;
+           segment++) {
+        ::unlink(segment_path(m_path, segment).c_str());
+      }
+      m_first_segment = first_segment;
+    } else {
+      ::unlink(tmp_path.c_str());
+    }
+    m_compaction_err = err;
+    m_is_compacting = false;
+  }
+
+  auto append(uint8_t type, const K* key, const V* value) -> err_t
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_is_open) {
+      return CHANGELOG_ERR_BAD;
+    }
+    if (m_err != ERR_OK) {
+      return m_err;
+    }
+    const bool was_empty = m_buffer.empty();
+    encode_record(m_buffer, type, key, value);
+    m_num_appended++;
+    // Wake the flusher up to start the batch timer, or to write a full batch
+    if (was_empty || m_buffer.size() >= m_options.max_commit_bytes) {
+      m_flusher_cv.notify_one();
+    }
+    return ERR_OK;
+  }
+
+public:
+  ChangeLog() = default;
+  ~ChangeLog() { close(); }
+  ChangeLog(const ChangeLog&) = delete;
+  auto operator=(const ChangeLog&) -> ChangeLog& = delete;
+
+  // replay loads the snapshot and log segments at "path" into "table" with
+  // put(), remove() and clear(). Do this before attaching the log to the
+  // table, or every replayed record is logged again. Finding nothing at
+  // "path" isn't an error.
+  template<typename Table>
+  static auto replay(const std::string& path, Table& table) -> err_t
+  {
+    std::string data;
+    uint64_t segment = 0;
+    auto err = read_snapshot_segment(path, data, segment);
+    if (err != ERR_OK) {
+      return err;
+    }
+    if (!data.empty()) {
+      data.erase(0, sizeof(s_snapshot_magic) + sizeof(uint64_t));
+      err = apply_records(data, table);
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    // Segments are numbered without gaps, so stop at the first missing one
+    for (; file_exists(segment_path(path, segment)); segment++) {
+      err = read_file(segment_path(path, segment), data);
+      if (err != ERR_OK) {
+        return err;
+      }
+      err = apply_records(data, table);
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    return ERR_OK;
+  }
+
+  // open starts a new log segment at "path" and starts the flusher thread.
+  // Existing segments are left alone, so replay() them first.
+  auto open(const std::string& path, ChangeLogOptions options = {}) -> err_t
+  {
+    if (m_flusher_thread.joinable()) {
+      return CHANGELOG_ERR_BAD;
+    }
+    std::string data;
+    uint64_t segment = 0;
+    auto err = read_snapshot_segment(path, data, segment);
+    if (err != ERR_OK) {
+      return err;
+    }
+    m_first_segment = segment;
+    while (file_exists(segment_path(path, segment))) {
+      segment++;
+    }
+    err = open_segment(path, segment, m_fd);
+    if (err != ERR_OK) {
+      return err;
+    }
+
+    m_path = path;
+    m_options = options;
+    m_is_open = true;
+    m_buffer.clear();
+    m_sealed_buffer.clear();
+    m_has_sealed_buffer = false;
+    m_segment = segment;
+    m_num_appended = 0;
+    m_num_durable = 0;
+    m_stop = false;
+    m_err = ERR_OK;
+    m_compaction_err = ERR_OK;
+    m_flusher_thread = std::thread(&ChangeLog::run_flusher, this);
+    return ERR_OK;
+  }
+
+  // close flushes everything that was appended, waits for any compaction to
+  // finish and stops the background threads
+  auto close() -> err_t
+  {
+    join_compaction_thread();
+    if (!m_flusher_thread.joinable()) {
+      return ERR_OK;
+    }
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_is_open = false;
+      m_stop = true;
+    }
+    m_flusher_cv.notify_one();
+    m_flusher_thread.join();
+    if (m_fd >= 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+    if (m_err != ERR_OK) {
+      return m_err;
+    }
+    return m_compaction_err;
+  }
+
+  auto append_put(const K& key, const V& value) -> err_t
+  {
+    return append(RECORD_PUT, &key, &value);
+  }
+
+  auto append_remove(const K& key) -> err_t
+  {
+    return append(RECORD_REMOVE, &key, nullptr);
+  }
+
+  auto append_clear() -> err_t
+  {
+    return append(RECORD_CLEAR, nullptr, nullptr);
+  }
+
+  // sync blocks until everything appended so far is on disk
+  auto sync() -> err_t
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!m_flusher_thread.joinable()) {
+      return CHANGELOG_ERR_BAD;
+    }
+    const uint64_t target = m_num_appended;
+    m_num_sync_waiters++;
+    m_flusher_cv.notify_one();
+    m_durable_cv.wait(lock, [this, target] {
+      return m_num_durable >= target || m_err != ERR_OK;
+    });
+    m_num_sync_waiters--;
+    return m_err;
+  }
+
+  // compact snapshots "table", which must hold exactly what was logged so
+  // far, and starts a new segment. Writing the snapshot and deleting the old
+  // segments happens in a background thread; this only copies the elements.
+  // Returns CHANGELOG_ERR_BUSY if the previous compaction hasn't finished, or
+  // the error of the previous compaction if it failed.
+  template<typename Table>
+  auto compact(Table& table) -> err_t
+  {
+    if (!m_flusher_thread.joinable()) {
+      return CHANGELOG_ERR_BAD;
+    }
+    if (m_is_compacting) {
+      return CHANGELOG_ERR_BUSY;
+    }
+    join_compaction_thread();
+    const err_t previous_err = m_compaction_err;
+    if (previous_err != ERR_OK) {
+      m_compaction_err = ERR_OK;
+      return previous_err;
+    }
+
+    std::string snapshot(s_snapshot_magic, sizeof(s_snapshot_magic));
+    snapshot.append(sizeof(uint64_t), '\0');
+    table.for_each([&snapshot](const K& key, const V& value) {
+      encode_record(snapshot, RECORD_PUT, &key, &value);
+    });
+
+    uint64_t first_segment = 0;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_err != ERR_OK) {
+        return m_err;
+      }
+      // The flusher hasn't picked up the last compaction's segment switch
+      if (m_has_sealed_buffer) {
+        return CHANGELOG_ERR_BUSY;
+      }
+      // Everything appended so far belongs to the old segment
+      m_sealed_buffer.swap(m_buffer);
+      m_has_sealed_buffer = true;
+      m_segment++;
+      first_segment = m_segment;
+    }
+    m_flusher_cv.notify_one();
+    std::memcpy(
+      &snapshot[sizeof(s_snapshot_magic)], &first_segment, sizeof(uint64_t));
+
+    m_is_compacting = true;
+    m_compaction_thread = std::thread(
+      &ChangeLog::run_compaction, this, std::move(snapshot), first_segment);
+    return ERR_OK;
+  }
+}; // class ChangeLog
+} // namespace
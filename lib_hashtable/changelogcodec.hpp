@@ -0,0 +1,48 @@
+#pragma once
+#include "err.hpp"
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace lib_hashtable {
+// ChangeLogCodec turns keys and values into bytes and back. Trivially
+// copyable types and std::string work out of the box; specialize this for
+// anything else you want to log. Encoding is in host byte order, so log files
+// aren't portable between machines of different endianness.
+template<typename T>
+struct ChangeLogCodec
+{
+  static constexpr bool supported = std::is_trivially_copyable_v<T>;
+
+  static void encode(const T& value, std::string& out)
+  {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+  static auto decode(const char* data, size_t size, T& out_value) -> bool
+  {
+    if (size != sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&out_value, data, sizeof(T));
+    return true;
+  }
+};
+
+template<>
+struct ChangeLogCodec<std::string>
+{
+  static constexpr bool supported = true;
+
+  static void encode(const std::string& value, std::string& out)
+  {
+    out.append(value);
+  }
+  static auto decode(const char* data, size_t size, std::string& out_value)
+    -> bool
+  {
+    out_value.assign(data, size);
+    return true;
+  }
+};
+} // namespace
@@ -0,0 +1,441 @@
+#pragma once
+#include "err.hpp"
+#include "hashtable.hpp"
+#include "mixhash.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace lib_hashtable {
+// CuckooTableBucket holds up to "slots_per_bucket" elements, plus one tag
+// byte per slot. A tag of 0 means the slot is empty. Elements are constructed
+// in place, so they live in the same cache line(s) as their tags.
+template<typename K, typename V, size_t slots_per_bucket>
+class CuckooTableBucket
+{
+private:
+  uint8_t m_tags[slots_per_bucket];
+  alignas(HashTableNode<K, V>) unsigned char m_storage
+    [slots_per_bucket][sizeof(HashTableNode<K, V>)];
+
+public:
+  CuckooTableBucket()
+    : m_tags()
+  {}
+  ~CuckooTableBucket()
+  {
+    for (size_t i = 0; i < slots_per_bucket; i++) {
+      if (m_tags[i]) {
+        erase(i);
+      }
+    }
+  }
+  CuckooTableBucket(const CuckooTableBucket&) = delete;
+  auto operator=(const CuckooTableBucket&) -> CuckooTableBucket& = delete;
+
+  auto tag(size_t slot) -> uint8_t { return m_tags[slot]; }
+  auto node(size_t slot) -> HashTableNode<K, V>&
+  {
+    return *std::launder(
+      reinterpret_cast<HashTableNode<K, V>*>(m_storage[slot]));
+  }
+
+  // find_empty returns the index of an empty slot, or slots_per_bucket if
+  // the bucket is full
+  auto find_empty() -> size_t
+  {
+    for (size_t i = 0; i < slots_per_bucket; i++) {
+      if (!m_tags[i]) {
+        return i;
+      }
+    }
+    return slots_per_bucket;
+  }
+
+  // emplace constructs "node" in an empty "slot"
+  void emplace(size_t slot, uint8_t a_tag, HashTableNode<K, V>&& a_node)
+  {
+    new (m_storage[slot]) HashTableNode<K, V>(std::move(a_node));
+    m_tags[slot] = a_tag;
+  }
+
+  // erase destroys the element in a full "slot"
+  void erase(size_t slot)
+  {
+    node(slot).~HashTableNode<K, V>();
+    m_tags[slot] = 0;
+  }
+};
+
+// CuckooTable is a bucketized cuckoo hash table. Every key has exactly two
+// candidate buckets, so get() and remove() read at most two buckets no matter
+// how the keys collide. put() makes room by moving elements to their other
+// bucket, and grows the table when it can't.
+//
+// It has the same put()/get()/remove() interface as HashTable, but the number
+// of buckets isn't fixed: "initial_buckets_size" is rounded up to a power of
+// two and doubles every time the table fills up.
+template<typename K, typename V, size_t slots_per_bucket = 4>
+class CuckooTable
+{
+  static_assert(slots_per_bucket >= 1 && slots_per_bucket <= 8,
+                "slots_per_bucket must be between 1 and 8");
+
+private:
+  using Bucket = CuckooTableBucket<K, V, slots_per_bucket>;
+
+  // put() gives up looking for a displacement path after visiting this many
+  // buckets and grows the table instead
+  static constexpr size_t s_max_bfs_buckets = 256;
+  // put() returns CUCKOOTABLE_ERR_FULL if growing this many times in a row
+  // still doesn't make room, and leaves the table as it was. This only
+  // happens when lots of keys share the exact same hash
+  static constexpr size_t s_max_grows_per_insert = 3;
+
+  Bucket* m_buckets;
+  size_t m_buckets_size;
+  size_t m_size{ 0 };
+  std::function<size_t(const K&)> m_get_key_hash_func;
+
+  // One step of a displacement path: the element in "parent_slot" of the
+  // parent entry's bucket can move into "bucket"
+  struct BfsEntry
+  {
+    size_t bucket;
+    size_t parent;
+    size_t parent_slot;
+  };
+  static constexpr size_t s_no_parent = static_cast<size_t>(-1);
+
+  static auto get_key_hash__default(const K& key) -> size_t
+  {
+    return std::hash<K>{}(key);
+  }
+
+  // hash_key scrambles the user's hash, so both the bucket indices and the
+  // tag get well-distributed bits
+  auto hash_key(const K& key) -> size_t
+  {
+    return static_cast<size_t>(
+      mix_hash(static_cast<uint64_t>(m_get_key_hash_func(key))));
+  }
+
+  static auto round_up_to_power_of_two(size_t n) -> size_t
+  {
+    size_t ret = 2;
+    while (ret < n) {
+      ret <<= 1;
+    }
+    return ret;
+  }
+
+  // Tags are the top byte of the hash. 0 marks an empty slot, so bump it
+  static auto tag_for(size_t hash) -> uint8_t
+  {
+    auto tag = static_cast<uint8_t>(hash >> ((sizeof(size_t) - 1) * 8));
+    return tag ? tag : 1;
+  }
+
+  auto primary_bucket(size_t hash) -> size_t
+  {
+    return hash & (m_buckets_size - 1);
+  }
+
+  // The second bucket comes from a scrambled copy of the hash, so keys that
+  // share a primary bucket get spread out. It's never the primary bucket.
+  auto secondary_bucket(size_t hash) -> size_t
+  {
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9e3779b97f4a7c15ULL;
+    mixed ^= mixed >> 32;
+    size_t ret = static_cast<size_t>(mixed) & (m_buckets_size - 1);
+    if (ret == primary_bucket(hash)) {
+      ret ^= 1;
+    }
+    return ret;
+  }
+
+  // alternate_bucket returns the other candidate bucket of the element in
+  // "slot" of "bucket"
+  auto alternate_bucket(size_t bucket, size_t slot) -> size_t
+  {
+    const size_t hash =
+      hash_key(m_buckets[bucket].node(slot).key());
+    const size_t primary = primary_bucket(hash);
+    return primary == bucket ? secondary_bucket(hash) : primary;
+  }
+
+  // find looks for "key" in both of its candidate buckets. Returns true and
+  // fills "out_bucket" and "out_slot" if it was found
+  auto find(const K& key, size_t& out_bucket, size_t& out_slot) -> bool
+  {
+    if (!m_buckets) {
+      return false;
+    }
+    const size_t hash = hash_key(key);
+    const uint8_t tag = tag_for(hash);
+    const size_t candidates[2] = { primary_bucket(hash),
+                                   secondary_bucket(hash) };
+    for (const size_t bucket : candidates) {
+      for (size_t slot = 0; slot < slots_per_bucket; slot++) {
+        // Only compare keys when the tag matches
+        if (m_buckets[bucket].tag(slot) == tag &&
+            m_buckets[bucket].node(slot).key() == key) {
+          out_bucket = bucket;
+          out_slot = slot;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // make_room breadth-first searches for a chain of moves that ends in an
+  // empty slot, starting from "key_hash"'s two candidate buckets. If it finds
+  // one, it carries out the moves and fills "out_bucket" and "out_slot" with
+  // the slot that was freed up. This is what bounds the cost of a put() on a
+  // full bucket: we only move elements once we know it'll work.
+  auto make_room(size_t key_hash, size_t& out_bucket, size_t& out_slot)
+    -> err_t
+  {
+    std::vector<BfsEntry> queue;
+    queue.reserve(s_max_bfs_buckets);
+    queue.push_back({ primary_bucket(key_hash), s_no_parent, 0 });
+    queue.push_back({ secondary_bucket(key_hash), s_no_parent, 0 });
+    for (size_t i = 0; i < queue.size(); i++) {
+      const size_t empty_slot = m_buckets[queue[i].bucket].find_empty();
+      if (empty_slot != slots_per_bucket) {
+        // Walk the path backwards, moving each element into the slot the
+        // previous move freed up
+        //    before: [a] -> [b] -> [ ]
+        //    after:  [ ] -> [a] -> [b]
+        size_t entry = i;
+        size_t free_slot = empty_slot;
+        while (queue[entry].parent != s_no_parent) {
+          auto& from = m_buckets[queue[queue[entry].parent].bucket];
+          auto& to = m_buckets[queue[entry].bucket];
+          const size_t from_slot = queue[entry].parent_slot;
+          to.emplace(free_slot, from.tag(from_slot),
+                     std::move(from.node(from_slot)));
+          from.erase(from_slot);
+          free_slot = from_slot;
+          entry = queue[entry].parent;
+        }
+        out_bucket = queue[entry].bucket;
+        out_slot = free_slot;
+        return ERR_OK;
+      }
+      // Bucket is full: every element in it could move to its other bucket
+      for (size_t slot = 0; slot < slots_per_bucket; slot++) {
+        if (queue.size() >= s_max_bfs_buckets) {
+          break;
+        }
+        queue.push_back({ alternate_bucket(queue[i].bucket, slot), i, slot });
+      }
+    }
+    return CUCKOOTABLE_ERR_FULL;
+  }
+
+  // copy_into_bigger copies every element into "out_bigger", a fresh table
+  // with twice as many buckets. It copies instead of moving so this table is
+  // left intact if we run out of memory halfway through
+  auto copy_into_bigger(CuckooTable& out_bigger) -> err_t
+  {
+    CuckooTable bigger(m_buckets_size * 2, m_get_key_hash_func);
+    auto err = bigger.allocate_buckets();
+    if (err != ERR_OK) {
+      return err;
+    }
+    for (size_t bucket = 0; bucket < m_buckets_size; bucket++) {
+      for (size_t slot = 0; slot < slots_per_bucket; slot++) {
+        if (!m_buckets[bucket].tag(slot)) {
+          continue;
+        }
+        err = bigger.insert_new(m_buckets[bucket].node(slot));
+        if (err != ERR_OK) {
+          return err;
+        }
+      }
+    }
+    out_bigger.swap_internals(bigger);
+    return ERR_OK;
+  }
+
+  // try_insert puts "node" in one of its candidate buckets, making room if
+  // needed, but never grows the table. "node" is only moved from if it
+  // returns ERR_OK
+  auto try_insert(size_t hash, HashTableNode<K, V>& node) -> err_t
+  {
+    size_t bucket = primary_bucket(hash);
+    size_t slot = m_buckets[bucket].find_empty();
+    if (slot == slots_per_bucket) {
+      bucket = secondary_bucket(hash);
+      slot = m_buckets[bucket].find_empty();
+    }
+    if (slot == slots_per_bucket) {
+      auto err = make_room(hash, bucket, slot);
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    m_buckets[bucket].emplace(slot, tag_for(hash), std::move(node));
+    m_size++;
+    return ERR_OK;
+  }
+
+  // insert_new inserts a node whose key is known not to be in the table
+  auto insert_new(HashTableNode<K, V> node) -> err_t
+  {
+    const size_t hash = hash_key(node.key());
+    auto err = try_insert(hash, node);
+    if (err != CUCKOOTABLE_ERR_FULL) {
+      return err;
+    }
+    // No path to an empty slot: grow a copy of the table until the node fits
+    // in it, and only then swap it in. If it never does, we keep our own
+    // buckets instead of holding on to grows that didn't help
+    CuckooTable bigger(m_buckets_size, m_get_key_hash_func);
+    CuckooTable* from = this;
+    for (size_t i = 0; i < s_max_grows_per_insert; i++) {
+      err = from->copy_into_bigger(bigger);
+      if (err != ERR_OK) {
+        return err;
+      }
+      from = &bigger;
+      err = bigger.try_insert(hash, node);
+      if (err == ERR_OK) {
+        swap_internals(bigger);
+        return ERR_OK;
+      }
+      if (err != CUCKOOTABLE_ERR_FULL) {
+        return err;
+      }
+    }
+    return err;
+  }
+
+  auto allocate_buckets() -> err_t
+  {
+    m_buckets = new (std::nothrow) Bucket[m_buckets_size];
+    if (!m_buckets) {
+      return ERR_NO_MEMORY;
+    }
+    return ERR_OK;
+  }
+
+  void swap_internals(CuckooTable& other)
+  {
+    std::swap(m_buckets, other.m_buckets);
+    std::swap(m_buckets_size, other.m_buckets_size);
+    std::swap(m_size, other.m_size);
+  }
+
+public:
+  explicit CuckooTable(size_t initial_buckets_size = 16)
+    : m_buckets(nullptr)
+    , m_buckets_size(round_up_to_power_of_two(initial_buckets_size))
+    , m_get_key_hash_func(get_key_hash__default)
+  {}
+  CuckooTable(size_t initial_buckets_size,
+              std::function<size_t(const K&)> get_key_hash_func)
+    : m_buckets(nullptr)
+    , m_buckets_size(round_up_to_power_of_two(initial_buckets_size))
+    , m_get_key_hash_func(get_key_hash_func)
+  {}
+  ~CuckooTable()
+  {
+    delete[] m_buckets;
+    m_buckets = nullptr;
+  }
+  CuckooTable(const CuckooTable&) = delete;
+  auto operator=(const CuckooTable&) -> CuckooTable& = delete;
+
+  // size returns the number of elements in the table
+  auto size() -> size_t { return m_size; }
+  auto buckets_size() -> size_t { return m_buckets_size; }
+  auto capacity() -> size_t { return m_buckets_size * slots_per_bucket; }
+
+  // for_each calls "func(key, value)" for every element, in no particular
+  // order. Don't put() or remove() from inside "func"
+  template<typename Func>
+  void for_each(Func func)
+  {
+    if (!m_buckets) {
+      return;
+    }
+    for (size_t bucket = 0; bucket < m_buckets_size; bucket++) {
+      for (size_t slot = 0; slot < slots_per_bucket; slot++) {
+        if (m_buckets[bucket].tag(slot)) {
+          auto& node = m_buckets[bucket].node(slot);
+          func(node.key(), node.value());
+        }
+      }
+    }
+  }
+
+  // clear removes every element, keeping the buckets for the next put()s
+  auto clear() -> err_t
+  {
+    if (m_buckets) {
+      for (size_t bucket = 0; bucket < m_buckets_size; bucket++) {
+        for (size_t slot = 0; slot < slots_per_bucket; slot++) {
+          if (m_buckets[bucket].tag(slot)) {
+            m_buckets[bucket].erase(slot);
+          }
+        }
+      }
+    }
+    m_size = 0;
+    return ERR_OK;
+  }
+
+  // put inserts "value" under "key", replacing the value if "key" is already
+  // there. Buckets are allocated on the first put().
+  auto put(const K& key, const V& value) -> err_t
+  {
+    if (!m_buckets) {
+      auto err = allocate_buckets();
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    size_t bucket = 0;
+    size_t slot = 0;
+    if (find(key, bucket, slot)) {
+      // if we found a duplicate, just replace the value
+      m_buckets[bucket].node(slot).set_value(value);
+      return ERR_OK;
+    }
+    return insert_new(HashTableNode<K, V>(key, value));
+  }
+
+  // get takes "const &key" and the value in "out_value" if it was found, or
+  // HASHTABLE_ERR_ELEMENT_NOT_FOUND if not found
+  auto get(const K& key, V& out_value) -> err_t
+  {
+    size_t bucket = 0;
+    size_t slot = 0;
+    if (!find(key, bucket, slot)) {
+      return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
+    }
+    out_value = m_buckets[bucket].node(slot).value();
+    return ERR_OK;
+  }
+
+  // remove takes "const &key" and removes it and value if it found it
+  // HASHTABLE_ERR_ELEMENT_NOT_FOUND if not found
+  auto remove(const K& key) -> err_t
+  {
+    size_t bucket = 0;
+    size_t slot = 0;
+    if (!find(key, bucket, slot)) {
+      return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
+    }
+    m_buckets[bucket].erase(slot);
+    m_size--;
+    return ERR_OK;
+  }
+}; // class CuckooTable
+} // namespace
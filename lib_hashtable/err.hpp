@@ -7,5 +7,10 @@ using err_t = enum {
   HASHTABLE_ERR_ELEMENT_NOT_FOUND,
   LINKEDLIST_ERR_BAD,
   LINKEDLIST_ERR_ELEMENT_NOT_FOUND,
+  BLOOMFILTER_ERR_BAD,
+  CUCKOOTABLE_ERR_FULL,
+  CHANGELOG_ERR_BAD,
+  CHANGELOG_ERR_IO,
+  CHANGELOG_ERR_BUSY,
 };
 } // namespace
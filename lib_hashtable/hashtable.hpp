@@ -1,7 +1,11 @@
 #pragma once
+#include "bloomfilter.hpp"
+#include "changelogcodec.hpp"
 #include "err.hpp"
 #include "linkedlist.hpp"
-#include <array>
+#include "unrolledlinkedlist.hpp"
+#include <functional>
+#include <utility>
 
 #define UNUSED(x)                                                              \
   do {                                                                         \
@@ -9,6 +13,10 @@
   } while (0);
 
 namespace lib_hashtable {
+// Defined in changelog.hpp, which only tables that log need to include
+template<typename K, typename V>
+class ChangeLog;
+
 template<typename K, typename V>
 class HashTableNode
 {
@@ -26,40 +34,346 @@ private:
   V m_value;
 };
 
-template<typename K, typename V, size_t buckets_size>
+struct HashTableStats
+{
+  // Number of get()/remove() calls that consulted the bloom filter
+  size_t bloom_filter_lookups{ 0 };
+  // Number of those where the filter said "definitely absent", so no bucket
+  // was touched
+  size_t bloom_filter_negatives{ 0 };
+  // Number of those where the filter said "maybe", but the key wasn't there
+  size_t bloom_filter_false_positives{ 0 };
+  size_t bloom_filter_size_in_bytes{ 0 };
+
+  // bloom_filter_false_positive_rate returns the observed probability that a
+  // lookup for a missing key made it past the filter. Use this to pick
+  // "bits_per_key" in HashTable::enable_bloom_filter()
+  auto bloom_filter_false_positive_rate() const -> double
+  {
+    const size_t misses =
+      bloom_filter_negatives + bloom_filter_false_positives;
+    if (misses == 0) {
+      return 0.0;
+    }
+    return static_cast<double>(bloom_filter_false_positives) /
+           static_cast<double>(misses);
+  }
+};
+
+// "Chain" is the list type each bucket uses: LinkedList, or UnrolledChain to
+// pack several elements per node. It needs a Pool type, a constructor taking
+// a Pool*, and insert_at_head(), find_if(), remove_first_if(), for_each(),
+// clear(), copy_from(), size(), empty() and num_nodes(). It has to take
+// exactly one template parameter: some compilers (e.g. Apple clang) won't
+// bind templates with extra defaulted ones, like UnrolledLinkedList itself
+template<typename K,
+         typename V,
+         size_t buckets_size,
+         template<typename> class Chain = LinkedList>
 class HashTable
 {
 private:
-  std::array<LinkedList<HashTableNode<K, V>>*, buckets_size> m_buckets;
-  const size_t m_buckets_size;
+  using Bucket = Chain<HashTableNode<K, V>>;
+  using Pool = typename Bucket::Pool;
+
+  // Both are allocated on the first put(), so moving a table only moves
+  // pointers. All buckets share the node pool
+  Bucket** m_buckets;
+  Pool* m_node_pool;
+  size_t m_buckets_size;
   std::function<size_t(const K&, const size_t)> m_get_key_hash_func;
+  // Optional, nullptr unless enable_bloom_filter() was called
+  BloomFilter* m_bloom_filter;
+  // Optional and not owned, nullptr unless set_change_log() was called
+  ChangeLog<K, V>* m_change_log;
+  // ChangeLog is only declared here, so set_change_log() also stores how to
+  // append to it. A nullptr "key" appends a clear, a nullptr "value" a remove
+  using AppendFunc = err_t (*)(ChangeLog<K, V>* change_log,
+                               const K* key,
+                               const V* value);
+  AppendFunc m_append_to_change_log;
+  HashTableStats m_stats;
+  // Only keys and values ChangeLogCodec knows about can be logged
+  static constexpr bool s_can_log =
+    ChangeLogCodec<K>::supported && ChangeLogCodec<V>::supported;
   static size_t get_key_hash__default(const K& key, const size_t max_size)
   {
     return std::hash<K>{}(key) % max_size;
   }
 
+  auto allocate_buckets() -> err_t
+  {
+    if (m_buckets) {
+      return ERR_OK;
+    }
+    if (!m_node_pool) {
+      m_node_pool = new (std::nothrow) Pool();
+      if (!m_node_pool) {
+        return ERR_NO_MEMORY;
+      }
+    }
+    m_buckets = new (std::nothrow) Bucket* [m_buckets_size]();
+    if (!m_buckets) {
+      return ERR_NO_MEMORY;
+    }
+    return ERR_OK;
+  }
+
+  // bloom_filter_may_contain returns false only if the bloom filter is
+  // enabled and says "key" is definitely not in the table
+  auto bloom_filter_may_contain(const K& key) -> bool
+  {
+    if (!m_bloom_filter) {
+      return true;
+    }
+    m_stats.bloom_filter_lookups++;
+    if (!m_bloom_filter->may_contain(std::hash<K>{}(key))) {
+      m_stats.bloom_filter_negatives++;
+      return false;
+    }
+    return true;
+  }
+
+  // count_bloom_filter_miss records that a lookup the bloom filter let
+  // through didn't find "key", whether its bucket was empty or not
+  void count_bloom_filter_miss()
+  {
+    if (m_bloom_filter) {
+      m_stats.bloom_filter_false_positives++;
+    }
+  }
+
+  // rebuild_bloom_filter clears the bloom filter and adds every key that's
+  // currently in the table. This drops the bits left over from removed keys
+  void rebuild_bloom_filter()
+  {
+    m_bloom_filter->clear();
+    for_each([this](const K& key, const V&) {
+      m_bloom_filter->add(std::hash<K>{}(key));
+    });
+  }
+
 public:
   HashTable()
-    : m_buckets()
+    : m_buckets(nullptr)
+    , m_node_pool(nullptr)
     , m_buckets_size(buckets_size)
     , m_get_key_hash_func(get_key_hash__default)
+    , m_bloom_filter(nullptr)
+    , m_change_log(nullptr)
+    , m_append_to_change_log(nullptr)
   {}
   HashTable(std::function<size_t(const K&, const size_t)> get_key_hash_func)
-    : m_buckets()
+    : m_buckets(nullptr)
+    , m_node_pool(nullptr)
     , m_buckets_size(buckets_size)
     , m_get_key_hash_func(get_key_hash_func)
+    , m_bloom_filter(nullptr)
+    , m_change_log(nullptr)
+    , m_append_to_change_log(nullptr)
   {}
   ~HashTable()
   {
     // Loop over all buckets and delete them
-    for (size_t i = 0; i < m_buckets_size; i++) {
-      delete m_buckets[i];
-      m_buckets[i] = nullptr;
+    if (m_buckets) {
+      for (size_t i = 0; i < m_buckets_size; i++) {
+        delete m_buckets[i];
+        m_buckets[i] = nullptr;
+      }
+    }
+    delete[] m_buckets;
+    m_buckets = nullptr;
+    // Only once every bucket gave its nodes back
+    delete m_node_pool;
+    m_node_pool = nullptr;
+    delete m_bloom_filter;
+    m_bloom_filter = nullptr;
+  }
+  // Copies would share buckets, use clone() instead
+  HashTable(const HashTable&) = delete;
+  auto operator=(const HashTable&) -> HashTable& = delete;
+  // Moving only swaps pointers. The moved-from table is empty and uses the
+  // default hash function
+  HashTable(HashTable&& other) noexcept
+    : HashTable()
+  {
+    swap(other);
+  }
+  auto operator=(HashTable&& other) noexcept -> HashTable&
+  {
+    HashTable moved(std::move(other));
+    swap(moved);
+    return *this;
+  }
+
+  // swap exchanges everything, including the bloom filter, stats and change
+  // log, with "other" in O(1)
+  void swap(HashTable& other) noexcept
+  {
+    std::swap(m_buckets, other.m_buckets);
+    std::swap(m_node_pool, other.m_node_pool);
+    std::swap(m_buckets_size, other.m_buckets_size);
+    std::swap(m_get_key_hash_func, other.m_get_key_hash_func);
+    std::swap(m_bloom_filter, other.m_bloom_filter);
+    std::swap(m_change_log, other.m_change_log);
+    std::swap(m_append_to_change_log, other.m_append_to_change_log);
+    std::swap(m_stats, other.m_stats);
+  }
+
+  // clone replaces "out_table" with a deep copy of this table. Nodes are
+  // copied into one contiguous slab, with memcpy if K and V are trivially
+  // copyable. The bloom filter and stats are copied too, the change log
+  // isn't: the clone doesn't log until set_change_log() is called on it.
+  // "out_table" is left alone if we run out of memory.
+  auto clone(HashTable& out_table) -> err_t
+  {
+    HashTable cloned(m_get_key_hash_func);
+    cloned.m_stats = m_stats;
+    if (m_bloom_filter) {
+      cloned.m_bloom_filter = new (std::nothrow) BloomFilter();
+      if (!cloned.m_bloom_filter) {
+        return ERR_NO_MEMORY;
+      }
+      auto err = cloned.m_bloom_filter->copy_from(*m_bloom_filter);
+      if (err != ERR_OK) {
+        return err;
+      }
+    }
+    if (m_buckets) {
+      size_t num_nodes = 0;
+      for (size_t i = 0; i < m_buckets_size; i++) {
+        if (m_buckets[i]) {
+          num_nodes += m_buckets[i]->num_nodes();
+        }
+      }
+      auto err = cloned.allocate_buckets();
+      if (err != ERR_OK) {
+        return err;
+      }
+      err = cloned.m_node_pool->reserve(num_nodes);
+      if (err != ERR_OK) {
+        return err;
+      }
+      for (size_t i = 0; i < m_buckets_size; i++) {
+        if (!m_buckets[i] || m_buckets[i]->empty()) {
+          continue;
+        }
+        cloned.m_buckets[i] = new (std::nothrow) Bucket(cloned.m_node_pool);
+        if (!cloned.m_buckets[i]) {
+          return ERR_NO_MEMORY;
+        }
+        err = cloned.m_buckets[i]->copy_from(*m_buckets[i]);
+        if (err != ERR_OK) {
+          return err;
+        }
+      }
     }
+    out_table.swap(cloned);
+    return ERR_OK;
+  }
+
+  // clear removes every element, keeping the buckets and node memory around
+  // for the next put()s. It doesn't call into the allocator at all. With a
+  // change log attached, a single "clear" record is logged.
+  auto clear() -> err_t
+  {
+    if (m_buckets) {
+      for (size_t i = 0; i < m_buckets_size; i++) {
+        if (m_buckets[i]) {
+          m_buckets[i]->clear();
+        }
+      }
+    }
+    if (m_bloom_filter) {
+      m_bloom_filter->clear();
+    }
+    if constexpr (s_can_log) {
+      if (m_change_log) {
+        return m_append_to_change_log(m_change_log, nullptr, nullptr);
+      }
+    }
+    return ERR_OK;
   }
 
   auto size() -> size_t { return m_buckets_size; };
 
+  // enable_bloom_filter puts a bloom filter in front of the buckets, so
+  // get() and remove() on missing keys usually return without walking any
+  // chain. "expected_keys" and "bits_per_key" size the filter (see
+  // BloomFilter::init()). Keys already in the table are added to it.
+  // Calling this again resizes the filter.
+  auto enable_bloom_filter(size_t expected_keys, size_t bits_per_key = 8)
+    -> err_t
+  {
+    const bool created = !m_bloom_filter;
+    if (created) {
+      m_bloom_filter = new (std::nothrow) BloomFilter();
+      if (!m_bloom_filter) {
+        return ERR_NO_MEMORY;
+      }
+    }
+    // A failed init() leaves the filter as it was, so a filter that was
+    // already enabled keeps working
+    auto err = m_bloom_filter->init(expected_keys, bits_per_key);
+    if (err != ERR_OK) {
+      if (created) {
+        delete m_bloom_filter;
+        m_bloom_filter = nullptr;
+      }
+      return err;
+    }
+    rebuild_bloom_filter();
+    m_stats = HashTableStats();
+    return ERR_OK;
+  }
+
+  // set_change_log makes every successful put() and remove() append a record
+  // to "change_log", and return its error if that fails. The table doesn't
+  // own the log. Pass nullptr to stop logging. Callers need to include
+  // changelog.hpp.
+  void set_change_log(ChangeLog<K, V>* change_log)
+  {
+    static_assert(s_can_log, "K and V need a ChangeLogCodec specialization");
+    m_change_log = change_log;
+    m_append_to_change_log =
+      [](ChangeLog<K, V>* log, const K* key, const V* value) -> err_t {
+      if (!key) {
+        return log->append_clear();
+      }
+      if (!value) {
+        return log->append_remove(*key);
+      }
+      return log->append_put(*key, *value);
+    };
+  }
+
+  // for_each calls "func(key, value)" for every element, in no particular
+  // order. Don't put() or remove() from inside "func"
+  template<typename Func>
+  void for_each(Func func)
+  {
+    if (!m_buckets) {
+      return;
+    }
+    for (size_t i = 0; i < m_buckets_size; i++) {
+      if (!m_buckets[i]) {
+        continue;
+      }
+      m_buckets[i]->for_each([&func](HashTableNode<K, V>& node) {
+        func(node.key(), node.value());
+      });
+    }
+  }
+
+  auto stats() -> HashTableStats
+  {
+    auto stats = m_stats;
+    if (m_bloom_filter) {
+      stats.bloom_filter_size_in_bytes = m_bloom_filter->size_in_bytes();
+    }
+    return stats;
+  }
+
   // put takes "key", creates a hashcode from it, and uses that hashcode as an
   // index to where it would copy "value" in the buckets. This happens by
   // making a LinkedList in the indexed location and inserting "value" to be
@@ -75,34 +389,39 @@ public:
     // Calculate hashcode from key
     /* const size_t key_hash = std::hash<K>{}(key) % m_buckets_size; */
     size_t key_hash = m_get_key_hash_func(key, m_buckets_size);
+    auto err = allocate_buckets();
+    if (err != ERR_OK) {
+      return err;
+    }
     // Take the result and place it in m_buckets
     if (!m_buckets[key_hash]) {
       // If there's no value there, make a new linkedlist
-      m_buckets[key_hash] =
-        new (std::nothrow) LinkedList<HashTableNode<K, V>>();
+      m_buckets[key_hash] = new (std::nothrow) Bucket(m_node_pool);
       if (!m_buckets[key_hash]) {
         return ERR_NO_MEMORY;
       }
     }
     // If there is, check if the key exists in the list
-    LinkedListNode<HashTableNode<K, V>>* iter = m_buckets[key_hash]->head();
-    bool did_find = false;
-    while (iter) {
-      if (iter->value().key() == key) {
-        // if we found a duplicate, just replace the value
-        iter->value().set_value(value);
-        did_find = true;
-        break;
-      }
-      iter = iter->next();
-    }
-    // If we didn't find a duplicate, insert this value in the list
-    if (!did_find) {
-      auto err =
+    auto* node = m_buckets[key_hash]->find_if(
+      [&key](HashTableNode<K, V>& n) { return n.key() == key; });
+    if (node) {
+      // if we found a duplicate, just replace the value
+      node->set_value(value);
+    } else {
+      // If we didn't find a duplicate, insert this value in the list
+      err =
         m_buckets[key_hash]->insert_at_head(HashTableNode<K, V>(key, value));
       if (err != ERR_OK) {
         return err;
       }
+      if (m_bloom_filter) {
+        m_bloom_filter->add(std::hash<K>{}(key));
+      }
+    }
+    if constexpr (s_can_log) {
+      if (m_change_log) {
+        return m_append_to_change_log(m_change_log, &key, &value);
+      }
     }
     return ERR_OK;
   }
@@ -111,26 +430,25 @@ public:
   // HASHTABLE_ERR_ELEMENT_NOT_FOUND if not found
   auto get(const K& key, V& out_value) -> err_t
   {
+    if (!bloom_filter_may_contain(key)) {
+      return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
+    }
     // Calculate hashcode from key
     const size_t key_hash = std::hash<K>{}(key) % m_buckets_size;
-    if (!m_buckets[key_hash]) {
+    if (!m_buckets || !m_buckets[key_hash]) {
+      count_bloom_filter_miss();
       return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
     }
     // loop over all nodes in the linked list
-    auto iter = m_buckets[key_hash]->head();
-    bool did_find = false;
-    while (iter) {
-      //   if node.key == key, return a copy of node.value
-      if (iter->value().key() == key) {
-        out_value = iter->value().value();
-        did_find = true;
-      }
-      iter = iter->next();
-    }
-    if (!did_find) {
+    //   if node.key == key, return a copy of node.value
+    auto* node = m_buckets[key_hash]->find_if(
+      [&key](HashTableNode<K, V>& n) { return n.key() == key; });
+    if (!node) {
+      count_bloom_filter_miss();
       //   else, return HASHTABLE_ERR_ELEMENT_NOT_FOUND
       return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
     }
+    out_value = node->value();
     return ERR_OK;
   }
 
@@ -138,30 +456,41 @@ public:
   // HASHTABLE_ERR_ELEMENT_NOT_FOUND if not found
   auto remove(const K& key) -> err_t
   {
+    if (!bloom_filter_may_contain(key)) {
+      return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
+    }
     // Calculate hashcode from key
     const size_t key_hash = std::hash<K>{}(key) % m_buckets_size;
-    if (!m_buckets[key_hash]) {
+    if (!m_buckets || !m_buckets[key_hash]) {
+      count_bloom_filter_miss();
       return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
     }
     // loop over all nodes in the linked list
-    auto iter = m_buckets[key_hash]->head();
-    bool did_find = false;
-    while (iter) {
-      //   if node.key == key, remove that specific node from the list
-      if (iter->value().key() == key) {
-        auto err = m_buckets[key_hash]->remove_node(iter);
-        if (err != ERR_OK) {
-          return err;
-        }
-        did_find = true;
-        break;
-      }
-      iter = iter->next();
+    //   if node.key == key, remove that specific node from the list
+    auto err = m_buckets[key_hash]->remove_first_if(
+      [&key](HashTableNode<K, V>& n) { return n.key() == key; });
+    if (err != ERR_OK && err != LINKEDLIST_ERR_ELEMENT_NOT_FOUND) {
+      return err;
     }
-    if (!did_find) {
+    if (err == LINKEDLIST_ERR_ELEMENT_NOT_FOUND) {
+      count_bloom_filter_miss();
       //   else, return HASHTABLE_ERR_ELEMENT_NOT_FOUND
       return HASHTABLE_ERR_ELEMENT_NOT_FOUND;
     }
+    // The filter can't unset the key's bits, so rebuild it once enough
+    // removed keys have piled up. A rebuild walks every bucket, so there have
+    // to be at least half as many removes as buckets too
+    if (m_bloom_filter) {
+      m_bloom_filter->mark_stale();
+      if (m_bloom_filter->needs_rebuild(m_buckets_size)) {
+        rebuild_bloom_filter();
+      }
+    }
+    if constexpr (s_can_log) {
+      if (m_change_log) {
+        return m_append_to_change_log(m_change_log, &key, nullptr);
+      }
+    }
     return ERR_OK;
   }
 }; // class HashTable
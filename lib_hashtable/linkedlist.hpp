@@ -1,5 +1,7 @@
 #pragma once
 #include "err.hpp"
+#include "nodepool.hpp"
+#include <cstddef>
 #include <new>
 #include <utility>
 
@@ -27,16 +29,45 @@ private:
   LinkedListNode<T>* m_next;
 };
 
+template<typename T>
+using LinkedListNodePool = NodePool<LinkedListNode<T>>;
+
 template<typename T>
 class LinkedList
 {
+public:
+  using Pool = LinkedListNodePool<T>;
+
 private:
   LinkedListNode<T>* m_head_node;
   size_t m_size{ 0 };
+  // Optional, nodes come from (and go back to) the heap if this is nullptr
+  LinkedListNodePool<T>* m_pool;
+
+  auto new_node(const T& value) -> LinkedListNode<T>*
+  {
+    if (m_pool) {
+      return m_pool->allocate(value);
+    }
+    return new (std::nothrow) LinkedListNode<T>(value);
+  }
+  void delete_node(LinkedListNode<T>* node)
+  {
+    if (m_pool) {
+      m_pool->release(node);
+      return;
+    }
+    delete node;
+  }
 
 public:
   LinkedList()
-    : m_head_node(nullptr){};
+    : m_head_node(nullptr)
+    , m_pool(nullptr){};
+  // Use "pool" for nodes. It has to outlive the list
+  explicit LinkedList(LinkedListNodePool<T>* pool)
+    : m_head_node(nullptr)
+    , m_pool(pool){};
   ~LinkedList()
   {
     while (m_head_node != nullptr) {
@@ -54,8 +85,8 @@ public:
   auto insert_at_head(const T& value) -> err_t
   {
     // Make a new node
-    auto* new_node = new (std::nothrow) LinkedListNode<T>(value);
-    if (!new_node) {
+    auto* node = new_node(value);
+    if (!node) {
       return ERR_NO_MEMORY;
     }
 
@@ -63,10 +94,10 @@ public:
     /* 2 -> 1 -> 0 */
     /* 3 */
     if (!m_head_node) {
-      m_head_node = new_node;
+      m_head_node = node;
     } else {
-      new_node->set_next(m_head_node);
-      m_head_node = new_node;
+      node->set_next(m_head_node);
+      m_head_node = node;
     }
     m_size++;
     return ERR_OK;
@@ -112,7 +143,7 @@ public:
         }
         did_find = true;
         m_size--;
-        delete target_node;
+        delete_node(target_node);
         target_node = nullptr;
         break;
       }
@@ -138,7 +169,7 @@ public:
     // after: 1 -> 0
     m_head_node = m_head_node->next();
     // delete node
-    delete popped_node;
+    delete_node(popped_node);
     popped_node = nullptr;
     m_size--;
     return ERR_OK;
@@ -158,10 +189,92 @@ public:
     // Assign out_value
     out_value = popped_node->value();
     // delete node
-    delete popped_node;
+    delete_node(popped_node);
     popped_node = 0;
     m_size--;
     return ERR_OK;
   }
+
+  // clear removes every node. With a pool, their memory goes back to it
+  void clear()
+  {
+    while (m_head_node != nullptr) {
+      remove_head();
+    }
+  }
+
+  // copy_from replaces this list's nodes with copies of "other"'s, in the
+  // same order
+  auto copy_from(LinkedList& other) -> err_t
+  {
+    clear();
+    LinkedListNode<T>* tail_node = nullptr;
+    for (auto* iter = other.head(); iter; iter = iter->next()) {
+      LinkedListNode<T>* node = nullptr;
+      if (m_pool) {
+        node = m_pool->allocate_copy(*iter);
+      } else {
+        node = new (std::nothrow) LinkedListNode<T>(iter->value());
+      }
+      if (!node) {
+        return ERR_NO_MEMORY;
+      }
+      // Append, so the order is the same as in "other"
+      if (!tail_node) {
+        m_head_node = node;
+      } else {
+        tail_node->set_next(node);
+      }
+      tail_node = node;
+      m_size++;
+    }
+    return ERR_OK;
+  }
+
+  // num_nodes returns how many nodes copy_from() needs to copy this list
+  auto num_nodes() -> size_t { return m_size; }
+
+  // find_if returns the first value "pred" returns true for, or nullptr
+  template<typename Pred>
+  auto find_if(Pred pred) -> T*
+  {
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      if (pred(iter->value())) {
+        return &iter->value();
+      }
+    }
+    return nullptr;
+  }
+
+  // remove_first_if removes the first value "pred" returns true for. Unlike
+  // remove_node(), this unlinks it without walking the list a second time
+  template<typename Pred>
+  auto remove_first_if(Pred pred) -> err_t
+  {
+    LinkedListNode<T>* prev_node = nullptr;
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      if (pred(iter->value())) {
+        if (prev_node) {
+          prev_node->set_next(iter->next());
+        } else {
+          m_head_node = iter->next();
+        }
+        m_size--;
+        delete_node(iter);
+        return ERR_OK;
+      }
+      prev_node = iter;
+    }
+    return LINKEDLIST_ERR_ELEMENT_NOT_FOUND;
+  }
+
+  // for_each calls "func(value)" for every value, head first
+  template<typename Func>
+  void for_each(Func func)
+  {
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      func(iter->value());
+    }
+  }
 };
 } // namespace
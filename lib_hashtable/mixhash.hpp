@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+namespace lib_hashtable {
+// mix_hash scrambles the bits of "hash" (murmur3 finalizer). std::hash is the
+// identity function for integers in most standard libraries, so use this
+// before taking bits out of a user's hash
+inline auto mix_hash(uint64_t hash) -> uint64_t
+{
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+} // namespace
@@ -0,0 +1,155 @@
+#pragma once
+#include "err.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lib_hashtable {
+// NodePool hands out list nodes carved from big slabs, and takes them back
+// for reuse instead of freeing them. Lists sharing a pool don't hit the
+// allocator once the pool is warm, and nodes allocated together end up next
+// to each other in memory. Slabs are only freed when the pool is.
+//
+// "Node" needs a copy constructor and a set_next() member.
+template<typename Node>
+class NodePool
+{
+private:
+  // What a node's memory holds while it sits in the free list
+  struct FreeNode
+  {
+    FreeNode* next;
+  };
+  // Every slab starts with one node-sized header slot linking it to the next
+  // slab, followed by the nodes themselves. Keeping the header node-sized
+  // keeps the nodes aligned
+  struct Slab
+  {
+    Slab* next;
+  };
+  static_assert(sizeof(FreeNode) <= sizeof(Node) &&
+                  sizeof(Slab) <= sizeof(Node),
+                "Nodes are always bigger than a pointer");
+
+  static constexpr bool s_is_over_aligned =
+    alignof(Node) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+  static constexpr size_t s_min_slab_nodes = 16;
+  static constexpr size_t s_max_slab_nodes = 4096;
+
+  FreeNode* m_free_head;
+  Slab* m_slabs;
+  size_t m_num_free{ 0 };
+  size_t m_next_slab_nodes{ s_min_slab_nodes };
+
+  auto add_slab(size_t num_nodes) -> err_t
+  {
+    const size_t size = (num_nodes + 1) * sizeof(Node);
+    void* memory = nullptr;
+    if constexpr (s_is_over_aligned) {
+      memory =
+        ::operator new(size, std::align_val_t(alignof(Node)), std::nothrow);
+    } else {
+      memory = ::operator new(size, std::nothrow);
+    }
+    if (!memory) {
+      return ERR_NO_MEMORY;
+    }
+    auto* slots = static_cast<unsigned char*>(memory);
+    m_slabs = new (slots) Slab{ m_slabs };
+    // Push in reverse, so nodes are handed out in address order
+    for (size_t i = num_nodes; i > 0; i--) {
+      m_free_head = new (slots + i * sizeof(Node)) FreeNode{ m_free_head };
+    }
+    m_num_free += num_nodes;
+    return ERR_OK;
+  }
+
+  // take returns memory for one node, or nullptr if we're out of memory
+  auto take() -> void*
+  {
+    if (!m_free_head) {
+      if (add_slab(m_next_slab_nodes) != ERR_OK) {
+        return nullptr;
+      }
+      m_next_slab_nodes = std::min(m_next_slab_nodes * 2, s_max_slab_nodes);
+    }
+    FreeNode* free_node = m_free_head;
+    m_free_head = free_node->next;
+    m_num_free--;
+    return free_node;
+  }
+
+public:
+  NodePool()
+    : m_free_head(nullptr)
+    , m_slabs(nullptr)
+  {}
+  ~NodePool()
+  {
+    while (m_slabs) {
+      Slab* next = m_slabs->next;
+      if constexpr (s_is_over_aligned) {
+        ::operator delete(m_slabs, std::align_val_t(alignof(Node)));
+      } else {
+        ::operator delete(m_slabs);
+      }
+      m_slabs = next;
+    }
+  }
+  NodePool(const NodePool&) = delete;
+  auto operator=(const NodePool&) -> NodePool& = delete;
+
+  auto num_free() -> size_t { return m_num_free; }
+
+  // reserve makes sure the next "num_nodes" allocations come out of the pool,
+  // carving any missing ones out of a single new slab
+  auto reserve(size_t num_nodes) -> err_t
+  {
+    if (m_num_free >= num_nodes) {
+      return ERR_OK;
+    }
+    return add_slab(num_nodes - m_num_free);
+  }
+
+  // allocate constructs a node from "args", or returns nullptr if we're out
+  // of memory
+  template<typename... Args>
+  auto allocate(Args&&... args) -> Node*
+  {
+    void* memory = take();
+    if (!memory) {
+      return nullptr;
+    }
+    return new (memory) Node(std::forward<Args>(args)...);
+  }
+
+  // allocate_copy returns a copy of "node" that isn't linked to anything.
+  // Trivially copyable nodes are copied with a plain memcpy
+  auto allocate_copy(Node& node) -> Node*
+  {
+    void* memory = take();
+    if (!memory) {
+      return nullptr;
+    }
+    Node* copy = nullptr;
+    if constexpr (std::is_trivially_copyable_v<Node>) {
+      std::memcpy(memory, &node, sizeof(Node));
+      copy = std::launder(static_cast<Node*>(memory));
+    } else {
+      copy = new (memory) Node(node);
+    }
+    copy->set_next(nullptr);
+    return copy;
+  }
+
+  void release(Node* node)
+  {
+    node->~Node();
+    m_free_head = new (static_cast<void*>(node)) FreeNode{ m_free_head };
+    m_num_free++;
+  }
+};
+} // namespace
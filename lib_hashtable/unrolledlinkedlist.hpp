@@ -0,0 +1,366 @@
+#pragma once
+#include "err.hpp"
+#include "nodepool.hpp"
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace lib_hashtable {
+// How many values an UnrolledLinkedListNode holds by default: as many as fit
+// in two cache lines next to the node's size and next pointer, but at least 2
+template<typename T>
+constexpr size_t unrolled_linked_list_default_values =
+  (128 - sizeof(size_t) - sizeof(void*)) / sizeof(T) > 2
+    ? (128 - sizeof(size_t) - sizeof(void*)) / sizeof(T)
+    : 2;
+
+// UnrolledLinkedListNode holds up to "values_per_node" values in place. Values
+// are packed at the front, oldest first: the list's head value is the last
+// one in its head node.
+template<typename T, size_t values_per_node>
+class alignas(64) UnrolledLinkedListNode
+{
+private:
+  size_t m_size;
+  UnrolledLinkedListNode* m_next;
+  alignas(T) unsigned char m_storage[values_per_node][sizeof(T)];
+
+public:
+  explicit UnrolledLinkedListNode(const T& a_value)
+    : m_size(0)
+    , m_next(nullptr)
+  {
+    push_back(a_value);
+  }
+  UnrolledLinkedListNode(const UnrolledLinkedListNode& other)
+    : m_size(other.m_size)
+    , m_next(other.m_next)
+  {
+    if constexpr (std::is_trivially_copyable_v<T>) {
+      std::memcpy(m_storage, other.m_storage, m_size * sizeof(T));
+    } else {
+      for (size_t i = 0; i < m_size; i++) {
+        new (m_storage[i]) T(other.value(i));
+      }
+    }
+  }
+  auto operator=(const UnrolledLinkedListNode&)
+    -> UnrolledLinkedListNode& = delete;
+  ~UnrolledLinkedListNode()
+  {
+    for (size_t i = 0; i < m_size; i++) {
+      value(i).~T();
+    }
+  }
+
+  auto size() -> size_t { return m_size; }
+  auto full() -> bool { return m_size == values_per_node; }
+  auto value(size_t index) -> T&
+  {
+    return *std::launder(reinterpret_cast<T*>(m_storage[index]));
+  }
+  auto value(size_t index) const -> const T&
+  {
+    return *std::launder(reinterpret_cast<const T*>(m_storage[index]));
+  }
+  auto next() -> UnrolledLinkedListNode* { return m_next; }
+  void set_next(UnrolledLinkedListNode* a_next) { m_next = a_next; }
+
+  // push_back appends "a_value". The node must not be full
+  void push_back(const T& a_value)
+  {
+    new (m_storage[m_size]) T(a_value);
+    m_size++;
+  }
+
+  void push_back(T&& a_value)
+  {
+    new (m_storage[m_size]) T(std::move(a_value));
+    m_size++;
+  }
+
+  // append_from moves every value of "newer", the node before this one in
+  // the list, behind ours. Both nodes must fit in this one
+  void append_from(UnrolledLinkedListNode& newer)
+  {
+    for (size_t i = 0; i < newer.m_size; i++) {
+      push_back(std::move(newer.value(i)));
+      newer.value(i).~T();
+    }
+    newer.m_size = 0;
+  }
+
+  // take_newest_from moves the "count" newest values of "older", the node
+  // after this one in the list, in front of ours
+  void take_newest_from(UnrolledLinkedListNode& older, size_t count)
+  {
+    // Shift ours up, last one first so we only construct into free slots
+    for (size_t i = m_size; i > 0; i--) {
+      new (m_storage[i - 1 + count]) T(std::move(value(i - 1)));
+      value(i - 1).~T();
+    }
+    const size_t first = older.m_size - count;
+    for (size_t i = 0; i < count; i++) {
+      new (m_storage[i]) T(std::move(older.value(first + i)));
+      older.value(first + i).~T();
+    }
+    m_size += count;
+    older.m_size -= count;
+  }
+
+  // erase removes the value at "index", shifting the ones after it down so
+  // the order stays the same
+  void erase(size_t index)
+  {
+    for (size_t i = index; i + 1 < m_size; i++) {
+      value(i) = std::move(value(i + 1));
+    }
+    m_size--;
+    value(m_size).~T();
+  }
+};
+
+template<typename T, size_t values_per_node>
+using UnrolledLinkedListNodePool =
+  NodePool<UnrolledLinkedListNode<T, values_per_node>>;
+
+// UnrolledLinkedList is a LinkedList that packs several values into every
+// node, so walking it costs one cache miss per node instead of one per value.
+// It has the same insert_at_head()/remove_node()/remove_head_and_return()
+// API, and can be used as HashTable's bucket chain.
+template<typename T,
+         size_t values_per_node = unrolled_linked_list_default_values<T>>
+class UnrolledLinkedList
+{
+  static_assert(values_per_node >= 1, "values_per_node can't be 0");
+
+public:
+  using Node = UnrolledLinkedListNode<T, values_per_node>;
+  using Pool = UnrolledLinkedListNodePool<T, values_per_node>;
+
+private:
+  Node* m_head_node;
+  size_t m_size{ 0 };
+  size_t m_num_nodes{ 0 };
+  // Optional, nodes come from (and go back to) the heap if this is nullptr
+  Pool* m_pool;
+
+  auto new_node(const T& value) -> Node*
+  {
+    if (m_pool) {
+      return m_pool->allocate(value);
+    }
+    return new (std::nothrow) Node(value);
+  }
+  void delete_node(Node* node)
+  {
+    if (m_pool) {
+      m_pool->release(node);
+      return;
+    }
+    delete node;
+  }
+
+  // erase_at removes the value at "index" in "node". "prev_node" is the node
+  // before it, or nullptr for the head.
+  //
+  // If that leaves "node" less than half full, it's merged into the node
+  // after it, or takes values from it if both don't fit in one node. That
+  // keeps every node but the last at least half full, so removes don't
+  // leave long chains of nearly empty nodes behind
+  void erase_at(Node* prev_node, Node* node, size_t index)
+  {
+    node->erase(index);
+    m_size--;
+    if (node->size() * 2 >= values_per_node && node->size() > 0) {
+      return;
+    }
+    auto* next_node = node->next();
+    if (!next_node && node->size() > 0) {
+      return;
+    }
+    if (next_node && node->size() + next_node->size() > values_per_node) {
+      node->take_newest_from(*next_node,
+                             (next_node->size() - node->size()) / 2);
+      return;
+    }
+    // "node"'s values are newer than "next_node"'s, so they go behind them
+    if (next_node) {
+      next_node->append_from(*node);
+    }
+    if (prev_node) {
+      prev_node->set_next(next_node);
+    } else {
+      m_head_node = next_node;
+    }
+    delete_node(node);
+    m_num_nodes--;
+  }
+
+public:
+  UnrolledLinkedList()
+    : m_head_node(nullptr)
+    , m_pool(nullptr)
+  {}
+  // Use "pool" for nodes. It has to outlive the list
+  explicit UnrolledLinkedList(Pool* pool)
+    : m_head_node(nullptr)
+    , m_pool(pool)
+  {}
+  ~UnrolledLinkedList() { clear(); }
+  UnrolledLinkedList(const UnrolledLinkedList&) = delete;
+  auto operator=(const UnrolledLinkedList&) -> UnrolledLinkedList& = delete;
+
+  auto head() -> Node* { return m_head_node; }
+  auto size() -> size_t { return m_size; }
+  auto empty() -> bool { return m_size == 0; }
+  auto num_nodes() -> size_t { return m_num_nodes; }
+
+  auto insert_at_head(const T& value) -> err_t
+  {
+    // Fill up the head node before making a new one
+    if (m_head_node && !m_head_node->full()) {
+      m_head_node->push_back(value);
+      m_size++;
+      return ERR_OK;
+    }
+    auto* node = new_node(value);
+    if (!node) {
+      return ERR_NO_MEMORY;
+    }
+    node->set_next(m_head_node);
+    m_head_node = node;
+    m_size++;
+    m_num_nodes++;
+    return ERR_OK;
+  }
+
+  // remove_node removes the value at "index" in "target_node"
+  auto remove_node(Node* target_node, size_t index) -> err_t
+  {
+    Node* prev_node = nullptr;
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      if (iter == target_node) {
+        if (index >= iter->size()) {
+          return LINKEDLIST_ERR_BAD;
+        }
+        erase_at(prev_node, iter, index);
+        return ERR_OK;
+      }
+      prev_node = iter;
+    }
+    return LINKEDLIST_ERR_ELEMENT_NOT_FOUND;
+  }
+
+  auto remove_head() -> err_t
+  {
+    if (!m_head_node) {
+      return LINKEDLIST_ERR_ELEMENT_NOT_FOUND;
+    }
+    erase_at(nullptr, m_head_node, m_head_node->size() - 1);
+    return ERR_OK;
+  }
+
+  auto remove_head_and_return(T& out_value) -> err_t
+  {
+    if (!m_head_node) {
+      return LINKEDLIST_ERR_ELEMENT_NOT_FOUND;
+    }
+    out_value = m_head_node->value(m_head_node->size() - 1);
+    erase_at(nullptr, m_head_node, m_head_node->size() - 1);
+    return ERR_OK;
+  }
+
+  // clear removes every node. With a pool, their memory goes back to it
+  void clear()
+  {
+    while (m_head_node) {
+      auto* next = m_head_node->next();
+      delete_node(m_head_node);
+      m_head_node = next;
+    }
+    m_size = 0;
+    m_num_nodes = 0;
+  }
+
+  // copy_from replaces this list's values with copies of "other"'s, in the
+  // same order and packed into the same number of nodes
+  auto copy_from(UnrolledLinkedList& other) -> err_t
+  {
+    clear();
+    Node* tail_node = nullptr;
+    for (auto* iter = other.head(); iter; iter = iter->next()) {
+      Node* node = nullptr;
+      if (m_pool) {
+        node = m_pool->allocate_copy(*iter);
+      } else {
+        node = new (std::nothrow) Node(*iter);
+        if (node) {
+          node->set_next(nullptr);
+        }
+      }
+      if (!node) {
+        return ERR_NO_MEMORY;
+      }
+      if (!tail_node) {
+        m_head_node = node;
+      } else {
+        tail_node->set_next(node);
+      }
+      tail_node = node;
+      m_size += node->size();
+      m_num_nodes++;
+    }
+    return ERR_OK;
+  }
+
+  // find_if returns the first value "pred" returns true for, or nullptr
+  template<typename Pred>
+  auto find_if(Pred pred) -> T*
+  {
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      for (size_t i = iter->size(); i > 0; i--) {
+        if (pred(iter->value(i - 1))) {
+          return &iter->value(i - 1);
+        }
+      }
+    }
+    return nullptr;
+  }
+
+  // remove_first_if removes the first value "pred" returns true for
+  template<typename Pred>
+  auto remove_first_if(Pred pred) -> err_t
+  {
+    Node* prev_node = nullptr;
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      for (size_t i = iter->size(); i > 0; i--) {
+        if (pred(iter->value(i - 1))) {
+          erase_at(prev_node, iter, i - 1);
+          return ERR_OK;
+        }
+      }
+      prev_node = iter;
+    }
+    return LINKEDLIST_ERR_ELEMENT_NOT_FOUND;
+  }
+
+  // for_each calls "func(value)" for every value, head first
+  template<typename Func>
+  void for_each(Func func)
+  {
+    for (auto* iter = m_head_node; iter; iter = iter->next()) {
+      for (size_t i = iter->size(); i > 0; i--) {
+        func(iter->value(i - 1));
+      }
+    }
+  }
+};
+
+// UnrolledChain is UnrolledLinkedList with the default node size, for use as
+// HashTable's "Chain": HashTable<K, V, 1024, UnrolledChain>
+template<typename T>
+using UnrolledChain = UnrolledLinkedList<T>;
+} // namespace
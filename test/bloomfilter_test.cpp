@@ -0,0 +1,76 @@
+#include "bloomfilter.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace lib_hashtable;
+
+TEST(BloomFilterTests, TestFunctional)
+{
+  // Make a filter
+  auto filter = BloomFilter();
+  auto err = filter.init(1000, 16);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(32, filter.num_blocks());
+  ASSERT_EQ(32 * 64, filter.size_in_bytes());
+  // Nothing was added, so nothing should be found
+  for (uint64_t i = 0; i < 1000; i++) {
+    ASSERT_FALSE(filter.may_contain(i)) << " : " << i;
+  }
+  // Add a few things & check there are no false negatives
+  for (uint64_t i = 0; i < 1000; i++) {
+    filter.add(i);
+  }
+  ASSERT_EQ(1000, filter.num_added());
+  for (uint64_t i = 0; i < 1000; i++) {
+    ASSERT_TRUE(filter.may_contain(i)) << " : " << i;
+  }
+  // Check things we never added. At 16 bits per key, we should be well below
+  // 1% false positives
+  size_t false_positives = 0;
+  for (uint64_t i = 1000; i < 101000; i++) {
+    if (filter.may_contain(i)) {
+      false_positives++;
+    }
+  }
+  ASSERT_LT(false_positives, 1000);
+  // Mark things stale & check when we need a rebuild
+  for (uint64_t i = 0; i < 499; i++) {
+    filter.mark_stale();
+  }
+  ASSERT_FALSE(filter.needs_rebuild());
+  filter.mark_stale();
+  ASSERT_TRUE(filter.needs_rebuild());
+  // If rebuilding costs more than re-adding what we have (e.g. the owner
+  // walks 4000 buckets to do it), we wait for more removes
+  ASSERT_FALSE(filter.needs_rebuild(4000));
+  for (uint64_t i = 500; i < 2000; i++) {
+    filter.mark_stale();
+  }
+  ASSERT_TRUE(filter.needs_rebuild(4000));
+  // Clear it, and check it is empty again
+  filter.clear();
+  ASSERT_EQ(0, filter.num_added());
+  ASSERT_EQ(0, filter.num_stale());
+  ASSERT_FALSE(filter.needs_rebuild());
+  for (uint64_t i = 0; i < 1000; i++) {
+    ASSERT_FALSE(filter.may_contain(i)) << " : " << i;
+  }
+}
+
+TEST(BloomFilterTests, TestBadInit)
+{
+  auto filter = BloomFilter();
+  auto err = filter.init(1000, 0);
+  ASSERT_EQ(err, BLOOMFILTER_ERR_BAD) << " : " << err;
+  // Tiny filters still get one block
+  err = filter.init(0, 8);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(1, filter.num_blocks());
+}
+
+auto
+main(int argc, char** argv) -> int
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
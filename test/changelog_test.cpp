@@ -0,0 +1,203 @@
+#include "changelog.hpp"
+#include "cuckootable.hpp"
+#include "hashtable.hpp"
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace lib_hashtable;
+
+// Returns a fresh path prefix in the test temp dir, with anything a previous
+// run left behind removed
+static auto
+make_log_path(const std::string& name) -> std::string
+{
+  auto path = ::testing::TempDir() + "lib_hashtable_" + name;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(::testing::TempDir())) {
+    if (entry.path().string().rfind(path, 0) == 0) {
+      std::filesystem::remove(entry.path());
+    }
+  }
+  return path;
+}
+
+TEST(ChangeLogTests, TestFunctional_replay)
+{
+  auto path = make_log_path("replay");
+  // Log a few changes through a table
+  {
+    auto log = ChangeLog<std::string, std::string>();
+    auto err = log.open(path);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    auto table = HashTable<std::string, std::string, 10>();
+    table.set_change_log(&log);
+    err = table.put("aaa", "111");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("bbb", "222");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("ccc", "333");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("ccc", "new_ccc_value");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.remove("aaa");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    // Failed removes aren't logged
+    err = table.remove("aaa");
+    ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+    err = log.sync();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("ddd", "444");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    // Everything before a clear() is dropped on replay
+    err = table.clear();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("bbb", "222");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("ccc", "new_ccc_value");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.put("ddd", "444");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    // Closing flushes whatever wasn't synced
+    err = log.close();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    // Appending to a closed log fails
+    err = table.put("eee", "555");
+    ASSERT_EQ(err, CHANGELOG_ERR_BAD) << " : " << err;
+  }
+  // Replay it into a new table
+  auto table = HashTable<std::string, std::string, 10>();
+  auto err = ChangeLog<std::string, std::string>::replay(path, table);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  std::string actual_value;
+  err = table.get("aaa", actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  err = table.get("bbb", actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("222", actual_value) << " : " << err;
+  err = table.get("ccc", actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("new_ccc_value", actual_value) << " : " << err;
+  err = table.get("ddd", actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("444", actual_value) << " : " << err;
+  // The "eee" put made it to the table, but not to the log
+  err = table.get("eee", actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(ChangeLogTests, TestFunctional_torn_tail)
+{
+  auto path = make_log_path("torn_tail");
+  {
+    auto log = ChangeLog<int, int>();
+    auto err = log.open(path);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    for (int i = 0; i < 100; i++) {
+      err = log.append_put(i, i * 2);
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+    }
+    err = log.close();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  // Chop off the end of the last record, like a crash mid-write would
+  auto segment = path + ".log.0";
+  std::filesystem::resize_file(segment,
+                               std::filesystem::file_size(segment) - 3);
+  auto table = CuckooTable<int, int>();
+  auto err = ChangeLog<int, int>::replay(path, table);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(99, table.size());
+  int actual_value = 0;
+  err = table.get(98, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(196, actual_value);
+  err = table.get(99, actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  // Reopening starts a new segment after the torn one
+  auto log = ChangeLog<int, int>();
+  err = log.open(path);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = log.append_put(99, 198);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = log.close();
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_TRUE(std::filesystem::exists(path + ".log.1"));
+  auto reopened_table = CuckooTable<int, int>();
+  err = ChangeLog<int, int>::replay(path, reopened_table);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(100, reopened_table.size());
+}
+
+TEST(ChangeLogTests, TestFunctional_compact)
+{
+  auto path = make_log_path("compact");
+  {
+    auto log = ChangeLog<int, std::string>();
+    auto err = log.open(path);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    auto table = HashTable<int, std::string, 10>();
+    table.set_change_log(&log);
+    for (int i = 0; i < 1000; i++) {
+      err = table.put(i, std::to_string(i));
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+    }
+    for (int i = 0; i < 500; i++) {
+      err = table.remove(i);
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+    }
+    err = log.compact(table);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    // Keep writing while the snapshot is written
+    for (int i = 1000; i < 1100; i++) {
+      err = table.put(i, std::to_string(i));
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+    }
+    err = table.remove(999);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = log.close();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  // The compacted segment is gone, the new one is still there
+  ASSERT_TRUE(std::filesystem::exists(path + ".snapshot"));
+  ASSERT_FALSE(std::filesystem::exists(path + ".log.0"));
+  ASSERT_TRUE(std::filesystem::exists(path + ".log.1"));
+  auto table = CuckooTable<int, std::string>();
+  auto err = ChangeLog<int, std::string>::replay(path, table);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(599, table.size());
+  std::string actual_value;
+  for (int i = 0; i < 1100; i++) {
+    err = table.get(i, actual_value);
+    if (i < 500 || i == 999) {
+      ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << i;
+    } else {
+      ASSERT_EQ(err, ERR_OK) << " : " << i;
+      ASSERT_EQ(std::to_string(i), actual_value) << " : " << i;
+    }
+  }
+}
+
+TEST(ChangeLogTests, TestBadState)
+{
+  auto log = ChangeLog<int, int>();
+  auto err = log.append_put(1, 1);
+  ASSERT_EQ(err, CHANGELOG_ERR_BAD) << " : " << err;
+  err = log.sync();
+  ASSERT_EQ(err, CHANGELOG_ERR_BAD) << " : " << err;
+  // Nothing to replay isn't an error
+  auto table = CuckooTable<int, int>();
+  err = ChangeLog<int, int>::replay(make_log_path("bad_state"), table);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(0, table.size());
+  // Opening somewhere we can't write fails
+  err = log.open("/nonexistent_dir/log");
+  ASSERT_EQ(err, CHANGELOG_ERR_IO) << " : " << err;
+}
+
+auto
+main(int argc, char** argv) -> int
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,114 @@
+#include "cuckootable.hpp"
+#include "hashtable.hpp"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <vector>
+
+using namespace lib_hashtable;
+
+// Report percentiles of "latencies_ns" as benchmark counters. The mean that
+// google-benchmark reports hides the slow lookups we actually care about.
+static void
+report_latency_percentiles(benchmark::State& state,
+                           std::vector<double>& latencies_ns)
+{
+  if (latencies_ns.empty()) {
+    return;
+  }
+  std::sort(latencies_ns.begin(), latencies_ns.end());
+  auto percentile = [&latencies_ns](double p) {
+    return latencies_ns[static_cast<size_t>(p * (latencies_ns.size() - 1))];
+  };
+  state.counters["p50_ns"] = percentile(0.5);
+  state.counters["p99_ns"] = percentile(0.99);
+  state.counters["p99.9_ns"] = percentile(0.999);
+  state.counters["max_ns"] = latencies_ns.back();
+}
+
+// Time every single get() on a table filled with 10000 keys
+template<typename Table>
+static void
+get_latency(benchmark::State& state, Table& table)
+{
+  const int num_keys = 10000;
+  for (int i = 0; i < num_keys; i++) {
+    auto err = table.put(std::to_string(i), std::to_string(i));
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+  }
+
+  std::vector<double> latencies_ns;
+  std::string value;
+  int i = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto key = std::to_string(i % num_keys);
+    state.ResumeTiming();
+
+    auto start = std::chrono::steady_clock::now();
+    auto err = table.get(key, value);
+    auto end = std::chrono::steady_clock::now();
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    latencies_ns.push_back(
+      std::chrono::duration<double, std::nano>(end - start).count());
+    state.ResumeTiming();
+    i++;
+  }
+  report_latency_percentiles(state, latencies_ns);
+}
+
+static void
+BENCHMARK_CuckooTable_get_latency(benchmark::State& state)
+{
+  auto table = CuckooTable<std::string, std::string>();
+  get_latency(state, table);
+}
+
+static void
+BENCHMARK_HashTable_get_latency(benchmark::State& state)
+{
+  // Fewer buckets than keys, so chains are ~40 elements long
+  auto table = HashTable<std::string, std::string, 0xff>();
+  get_latency(state, table);
+}
+
+// Time every single put() of a new key, so the puts that have to make room
+// or grow the table show up in the tail
+static void
+BENCHMARK_CuckooTable_put(benchmark::State& state)
+{
+  auto table = CuckooTable<std::string, std::string>();
+  std::vector<double> latencies_ns;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto key = std::to_string(i);
+    auto value = std::to_string(i);
+    state.ResumeTiming();
+
+    auto start = std::chrono::steady_clock::now();
+    auto err = table.put(key, value);
+    auto end = std::chrono::steady_clock::now();
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    latencies_ns.push_back(
+      std::chrono::duration<double, std::nano>(end - start).count());
+    state.ResumeTiming();
+    i++;
+  }
+  report_latency_percentiles(state, latencies_ns);
+}
+
+BENCHMARK(BENCHMARK_CuckooTable_get_latency);
+BENCHMARK(BENCHMARK_HashTable_get_latency);
+BENCHMARK(BENCHMARK_CuckooTable_put);
+BENCHMARK_MAIN();
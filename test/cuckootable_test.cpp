@@ -0,0 +1,112 @@
+#include "cuckootable.hpp"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace lib_hashtable;
+
+TEST(CuckooTableTests, TestFunctional_string_to_string)
+{
+  // Make a table
+  auto table = CuckooTable<std::string, std::string>();
+  // Add a few elements
+  auto err = table.put("aaa", "111");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.put("bbb", "222");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.put("ccc", "333");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(3, table.size());
+  // Add a value to the same key, and check if it is overridden properly
+  err = table.put("ccc", "new_ccc_value");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(3, table.size());
+  std::string actual_value;
+  err = table.get("ccc", actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("new_ccc_value", actual_value) << " : " << err;
+  // Get a value
+  err = table.get("aaa", actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("111", actual_value) << " : " << err;
+  // Try to get a bad value
+  err = table.get("bunnyfoofoo", actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  // Get a value and see if it is still there
+  err = table.remove("aaa");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(2, table.size());
+  err = table.get("aaa", actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  err = table.remove("aaa");
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(CuckooTableTests, TestFunctional_grow)
+{
+  // Start tiny so we displace and grow a lot
+  auto table = CuckooTable<int, std::string>(2);
+  ASSERT_EQ(2, table.buckets_size());
+  for (int i = 0; i < 10000; i++) {
+    auto err = table.put(i, std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(10000, table.size());
+  ASSERT_GE(table.capacity(), 10000);
+  // Everything should survive displacement and growth
+  std::string actual_value;
+  for (int i = 0; i < 10000; i++) {
+    auto err = table.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+  }
+  // Remove half of them, and check the other half is still there
+  for (int i = 0; i < 10000; i += 2) {
+    auto err = table.remove(i);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(5000, table.size());
+  for (int i = 0; i < 10000; i++) {
+    auto err = table.get(i, actual_value);
+    if (i % 2 == 0) {
+      ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+    } else {
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+      ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+    }
+  }
+}
+
+TEST(CuckooTableTests, TestFunctional_same_hash)
+{
+  // Every key has the same two buckets, so only 2 * 4 of them fit no matter
+  // how much the table grows
+  auto table = CuckooTable<int, std::string>(
+    16, [](const auto key) { return static_cast<size_t>(key) & 0; });
+  for (int i = 0; i < 8; i++) {
+    auto err = table.put(i, std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(16, table.buckets_size());
+  // Failed puts shouldn't grow the table, no matter how often we retry
+  auto err = ERR_OK;
+  for (int i = 0; i < 10; i++) {
+    err = table.put(8, "8");
+    ASSERT_EQ(err, CUCKOOTABLE_ERR_FULL) << " : " << err;
+    ASSERT_EQ(16, table.buckets_size());
+  }
+  // The table should be intact
+  ASSERT_EQ(8, table.size());
+  std::string actual_value;
+  for (int i = 0; i < 8; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+  }
+}
+
+auto
+main(int argc, char** argv) -> int
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
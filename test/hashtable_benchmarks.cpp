@@ -1,5 +1,7 @@
+#include "changelog.hpp"
 #include "hashtable.hpp"
 #include <benchmark/benchmark.h>
+#include <filesystem>
 
 using namespace lib_hashtable;
 
@@ -72,7 +74,131 @@ BENCHMARK_HashTable_remove(benchmark::State& state)
   }
 }
 
+static void
+BENCHMARK_HashTable_get_missing(benchmark::State& state)
+{
+  // Few buckets and lots of keys, so every miss walks a long chain
+  auto table = HashTable<std::string, std::string, 0xff>();
+  if (state.range(0)) {
+    auto err = table.enable_bloom_filter(10000);
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+  }
+  for (uint64_t i = 0; i < 10000; i++) {
+    auto err = table.put(std::to_string(i), std::to_string(i));
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+  }
+
+  std::string value;
+  uint64_t i = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto key = "missing" + std::to_string(i);
+    state.ResumeTiming();
+
+    auto err = table.get(key, value);
+
+    state.PauseTiming();
+    if (err != HASHTABLE_ERR_ELEMENT_NOT_FOUND) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    state.ResumeTiming();
+    i++;
+  }
+  state.counters["false_positive_rate"] =
+    table.stats().bloom_filter_false_positive_rate();
+}
+
+static void
+BENCHMARK_HashTable_put_with_change_log(benchmark::State& state)
+{
+  const std::string path = "hashtable_benchmarks_changelog";
+  auto log = ChangeLog<std::string, std::string>();
+  auto err = log.open(path);
+  if (err != ERR_OK) {
+    state.SkipWithError(std::to_string((int)err).c_str());
+  }
+  auto table = HashTable<std::string, std::string, 0xffff>();
+  table.set_change_log(&log);
+  uint64_t i = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto key = std::to_string(i);
+    auto value = std::to_string(i);
+    state.ResumeTiming();
+
+    err = table.put(key, value);
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    state.ResumeTiming();
+    i++;
+  }
+  log.close();
+  for (uint64_t segment = 0;
+       std::filesystem::remove(path + ".log." + std::to_string(segment));
+       segment++) {
+  }
+}
+
+static void
+BENCHMARK_HashTable_clone(benchmark::State& state)
+{
+  auto table = HashTable<int, int, 0xffff>();
+  for (int i = 0; i < 10000; i++) {
+    auto err = table.put(i, i);
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+  }
+
+  for (auto _ : state) {
+    auto cloned = HashTable<int, int, 0xffff>();
+    auto err = table.clone(cloned);
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    state.ResumeTiming();
+  }
+}
+
+static void
+BENCHMARK_HashTable_clear(benchmark::State& state)
+{
+  auto table = HashTable<int, int, 0xffff>();
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (int i = 0; i < 10000; i++) {
+      auto err = table.put(i, i);
+      if (err != ERR_OK) {
+        state.SkipWithError(std::to_string((int)err).c_str());
+      }
+    }
+    state.ResumeTiming();
+
+    auto err = table.clear();
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    state.ResumeTiming();
+  }
+}
+
 BENCHMARK(BENCHMARK_HashTable_put);
 BENCHMARK(BENCHMARK_HashTable_get);
 BENCHMARK(BENCHMARK_HashTable_remove);
+BENCHMARK(BENCHMARK_HashTable_put_with_change_log);
+BENCHMARK(BENCHMARK_HashTable_clone);
+BENCHMARK(BENCHMARK_HashTable_clear);
+// 0: without a bloom filter, 1: with one
+BENCHMARK(BENCHMARK_HashTable_get_missing)->Arg(0)->Arg(1);
 BENCHMARK_MAIN();
@@ -1,6 +1,7 @@
 #include "hashtable.hpp"
 #include <gtest/gtest.h>
 #include <string>
+#include <type_traits>
 
 using namespace lib_hashtable;
 
@@ -143,6 +144,224 @@ TEST(HashTableTests, TestFunctional_string_to_string)
   ASSERT_EQ("my_value", actual_value) << " : " << err;
 }
 
+TEST(HashTableTests, TestFunctional_bloom_filter)
+{
+  // Make a table with a few elements already in it
+  auto table = HashTable<int, std::string, 10>();
+  auto err = table.put(111, "111");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.put(222, "222");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  // Enable the filter. Existing elements should be found through it
+  err = table.enable_bloom_filter(1000, 16);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(64 * 32, table.stats().bloom_filter_size_in_bytes);
+  // Resizing it with bad arguments fails, but keeps the filter we have
+  err = table.enable_bloom_filter(1000, 0);
+  ASSERT_EQ(err, BLOOMFILTER_ERR_BAD) << " : " << err;
+  ASSERT_EQ(64 * 32, table.stats().bloom_filter_size_in_bytes);
+  std::string actual_value;
+  err = table.get(111, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("111", actual_value) << " : " << err;
+  // Add a bunch more and make sure all of them are found
+  for (int i = 1000; i < 2000; i++) {
+    err = table.put(i, std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  for (int i = 1000; i < 2000; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+  }
+  // Look up a bunch of missing keys. Most of them should be stopped by the
+  // filter
+  for (int i = 10000; i < 20000; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  }
+  auto stats = table.stats();
+  ASSERT_EQ(10000 + 1001, stats.bloom_filter_lookups);
+  ASSERT_EQ(10000,
+            stats.bloom_filter_negatives + stats.bloom_filter_false_positives);
+  ASSERT_LT(stats.bloom_filter_false_positive_rate(), 0.01);
+  // Remove most of the elements. This rebuilds the filter along the way, and
+  // nothing that is still in the table should go missing
+  for (int i = 1000; i < 1900; i++) {
+    err = table.remove(i);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  }
+  for (int i = 1900; i < 2000; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+  }
+  err = table.get(222, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("222", actual_value) << " : " << err;
+  err = table.remove(1000);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(HashTableTests, TestFunctional_move_swap_clone_clear)
+{
+  // Moves and swaps can't fail, so containers can rely on them
+  static_assert(
+    std::is_nothrow_move_constructible_v<HashTable<int, std::string, 10>>);
+  static_assert(
+    std::is_nothrow_move_assignable_v<HashTable<int, std::string, 10>>);
+  static_assert(std::is_nothrow_swappable_v<HashTable<int, std::string, 10>>);
+  // Make a table
+  auto table = HashTable<int, std::string, 10>();
+  for (int i = 0; i < 100; i++) {
+    auto err = table.put(i, std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  auto err = table.enable_bloom_filter(100);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  // Move it. The old one should be empty, but still usable
+  auto moved = std::move(table);
+  std::string actual_value;
+  err = moved.get(42, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("42", actual_value) << " : " << err;
+  err = table.get(42, actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  err = table.put(1000, "1000");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  // Swap them back
+  table.swap(moved);
+  err = table.get(42, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = moved.get(1000, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("1000", actual_value) << " : " << err;
+  // Clone it, and check the clone doesn't share anything with the original
+  auto cloned = HashTable<int, std::string, 10>();
+  err = cloned.put(2000, "2000");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.clone(cloned);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = cloned.get(2000, actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  for (int i = 0; i < 100; i++) {
+    err = cloned.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(std::to_string(i), actual_value) << " : " << err;
+  }
+  err = table.put(42, "changed");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = cloned.get(42, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("42", actual_value) << " : " << err;
+  ASSERT_EQ(table.stats().bloom_filter_size_in_bytes,
+            cloned.stats().bloom_filter_size_in_bytes);
+  // Move-assign over a full table
+  cloned = std::move(moved);
+  err = cloned.get(1000, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = cloned.get(42, actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  // Clear it, and check everything is gone but the table still works
+  err = table.clear();
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  for (int i = 0; i < 100; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  }
+  err = table.put(42, "42 again");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.get(42, actual_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ("42 again", actual_value) << " : " << err;
+}
+
+TEST(HashTableTests, TestFunctional_clone_trivially_copyable)
+{
+  auto table = HashTable<int, int, 10>();
+  for (int i = 0; i < 1000; i++) {
+    auto err = table.put(i, i * 2);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  auto cloned = HashTable<int, int, 10>();
+  auto err = table.clone(cloned);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  int actual_value = 0;
+  for (int i = 0; i < 1000; i++) {
+    err = cloned.get(i, actual_value);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(i * 2, actual_value) << " : " << err;
+  }
+  // Cloning an empty table empties the target
+  auto empty = HashTable<int, int, 10>();
+  err = empty.clone(cloned);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = cloned.get(1, actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(HashTableTests, TestFunctional_unrolled_linked_list_chains)
+{
+  // Few buckets, so chains span several nodes
+  auto table = HashTable<std::string, std::string, 4, UnrolledChain>();
+  for (int i = 0; i < 1000; i++) {
+    auto err = table.put(std::to_string(i), std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  // Overwrite some
+  for (int i = 0; i < 1000; i += 3) {
+    auto err = table.put(std::to_string(i), "new");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  // Remove some
+  for (int i = 0; i < 1000; i += 2) {
+    auto err = table.remove(std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  auto cloned = HashTable<std::string, std::string, 4, UnrolledChain>();
+  auto err = table.clone(cloned);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  std::string actual_value;
+  for (int i = 0; i < 1000; i++) {
+    err = cloned.get(std::to_string(i), actual_value);
+    if (i % 2 == 0) {
+      ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+    } else {
+      ASSERT_EQ(err, ERR_OK) << " : " << err;
+      ASSERT_EQ(i % 3 == 0 ? "new" : std::to_string(i), actual_value);
+    }
+  }
+  err = table.clear();
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = table.get("1", actual_value);
+  ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(HashTableTests, TestFunctional_bloom_filter_more_buckets_than_keys)
+{
+  // Most buckets are empty, and a tiny filter lets most misses through.
+  // Those still count as false positives
+  auto table = HashTable<int, int, 100000>();
+  auto err = table.enable_bloom_filter(1, 1);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  for (int i = 0; i < 100; i++) {
+    err = table.put(i, i);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  int actual_value = 0;
+  for (int i = 1000; i < 11000; i++) {
+    err = table.get(i, actual_value);
+    ASSERT_EQ(err, HASHTABLE_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  }
+  auto stats = table.stats();
+  ASSERT_EQ(10000, stats.bloom_filter_lookups);
+  ASSERT_EQ(10000,
+            stats.bloom_filter_negatives + stats.bloom_filter_false_positives);
+  ASSERT_GT(stats.bloom_filter_false_positive_rate(), 0.05);
+}
+
 TEST(HashTableTests, TestBenchmarks)
 {
   // Make a table
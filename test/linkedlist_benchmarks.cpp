@@ -1,4 +1,5 @@
 #include "linkedlist.hpp"
+#include "unrolledlinkedlist.hpp"
 #include <benchmark/benchmark.h>
 
 using namespace lib_hashtable;
@@ -49,6 +50,61 @@ BENCHMARK_LinkedList_remove_head(benchmark::State& state)
   }
 }
 
+// The templated benchmarks below compare LinkedList against
+// UnrolledLinkedList on the operations hash table chains do most
+
+template<typename List>
+static void
+BENCHMARK_List_insert_at_head(benchmark::State& state)
+{
+  auto list = List();
+  uint64_t i = 0;
+  for (auto _ : state) {
+    auto err = list.insert_at_head(i);
+
+    state.PauseTiming();
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+    state.ResumeTiming();
+    i++;
+  }
+}
+
+// Walk a whole list of state.range(0) values looking for one that isn't
+// there, which is what a missed lookup in a hash table chain does
+template<typename List>
+static void
+BENCHMARK_List_traverse(benchmark::State& state)
+{
+  auto list = List();
+  const auto num_values = static_cast<uint64_t>(state.range(0));
+  for (uint64_t i = 0; i < num_values; i++) {
+    auto err = list.insert_at_head(i);
+    if (err != ERR_OK) {
+      state.SkipWithError(std::to_string((int)err).c_str());
+    }
+  }
+
+  for (auto _ : state) {
+    auto* found = list.find_if(
+      [num_values](uint64_t value) { return value == num_values; });
+    benchmark::DoNotOptimize(found);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
 BENCHMARK(BENCHMARK_LinkedList_insert_at_head);
 BENCHMARK(BENCHMARK_LinkedList_remove_head);
+BENCHMARK_TEMPLATE(BENCHMARK_List_insert_at_head, LinkedList<uint64_t>);
+BENCHMARK_TEMPLATE(BENCHMARK_List_insert_at_head,
+                   UnrolledLinkedList<uint64_t>);
+BENCHMARK_TEMPLATE(BENCHMARK_List_traverse, LinkedList<uint64_t>)
+  ->Arg(8)
+  ->Arg(64)
+  ->Arg(4096);
+BENCHMARK_TEMPLATE(BENCHMARK_List_traverse, UnrolledLinkedList<uint64_t>)
+  ->Arg(8)
+  ->Arg(64)
+  ->Arg(4096);
 BENCHMARK_MAIN();
@@ -64,6 +64,67 @@ TEST(LinkedListTests, TestFunctional)
   ASSERT_EQ("bunnyfoofoo", list.head()->value());
 }
 
+TEST(LinkedListTests, TestFunctional_pool)
+{
+  auto pool = LinkedListNodePool<std::string>();
+  err_t err = pool.reserve(4);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(4, pool.num_free());
+  {
+    // Lists take nodes from the pool...
+    auto list = LinkedList<std::string>(&pool);
+    err = list.insert_at_head("aaa");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = list.insert_at_head("bbb");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    err = list.insert_at_head("ccc");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(1, pool.num_free());
+    // ...and give them back
+    err = list.remove_node(list.head()->next());
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(2, pool.num_free());
+    // Copies come out in the same order
+    auto copy = LinkedList<std::string>(&pool);
+    err = copy.copy_from(list);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    ASSERT_EQ(2, copy.size());
+    ASSERT_EQ("ccc", copy.head()->value());
+    ASSERT_EQ("aaa", copy.head()->next()->value());
+    ASSERT_EQ(nullptr, copy.head()->next()->next());
+    ASSERT_EQ(0, pool.num_free());
+    // Run out of reserved nodes, so the pool grows
+    err = copy.insert_at_head("ddd");
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+    list.clear();
+    ASSERT_TRUE(list.empty());
+    ASSERT_EQ(nullptr, list.head());
+  }
+  // Every node went back to the pool
+  ASSERT_LE(4 + 1, pool.num_free());
+}
+
+TEST(LinkedListTests, TestFunctional_copy_without_pool)
+{
+  auto list = LinkedList<int>();
+  for (int i = 0; i < 10; i++) {
+    auto err = list.insert_at_head(i);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  auto copy = LinkedList<int>();
+  auto err = copy.insert_at_head(100);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = copy.copy_from(list);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(10, copy.size());
+  int expected = 9;
+  for (auto* node = copy.head(); node; node = node->next()) {
+    ASSERT_EQ(expected, node->value());
+    expected--;
+  }
+  ASSERT_EQ(-1, expected);
+}
+
 auto
 main(int argc, char** argv) -> int
 {
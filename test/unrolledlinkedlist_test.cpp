@@ -0,0 +1,153 @@
+#include "unrolledlinkedlist.hpp"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace lib_hashtable;
+
+// Returns the list's values, head first
+template<typename T, size_t values_per_node>
+static auto
+to_vector(UnrolledLinkedList<T, values_per_node>& list) -> std::vector<T>
+{
+  std::vector<T> values;
+  list.for_each([&values](const T& value) { values.push_back(value); });
+  return values;
+}
+
+TEST(UnrolledLinkedListTests, TestFunctional)
+{
+  // Make a list with 2 values per node, so we use a few nodes
+  auto list = UnrolledLinkedList<std::string, 2>();
+  // Insert few things & check
+  auto err = list.insert_at_head("aaa");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(1, list.size()) << " : " << err;
+  ASSERT_EQ(1, list.num_nodes()) << " : " << err;
+  err = list.insert_at_head("bbb");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(2, list.size()) << " : " << err;
+  ASSERT_EQ(1, list.num_nodes()) << " : " << err;
+  err = list.insert_at_head("ccc");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(3, list.size()) << " : " << err;
+  ASSERT_EQ(2, list.num_nodes()) << " : " << err;
+  err = list.insert_at_head("ddd");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(4, list.size()) << " : " << err;
+  ASSERT_EQ(2, list.num_nodes()) << " : " << err;
+  ASSERT_EQ((std::vector<std::string>{ "ddd", "ccc", "bbb", "aaa" }),
+            to_vector(list));
+  // Remove an element
+  std::string torn_value;
+  err = list.remove_head_and_return(torn_value);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(3, list.size()) << " : " << err;
+  ASSERT_EQ("ddd", torn_value);
+  ASSERT_EQ((std::vector<std::string>{ "ccc", "bbb", "aaa" }),
+            to_vector(list));
+  // Remove the oldest value in the second node and check if order is as
+  // expected
+  auto* target_node = list.head()->next();
+  ASSERT_EQ("aaa", target_node->value(0));
+  err = list.remove_node(target_node, 0);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ((std::vector<std::string>{ "ccc", "bbb" }), to_vector(list));
+  // Empty the head node, so it gets unlinked
+  err = list.remove_head();
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(1, list.num_nodes()) << " : " << err;
+  ASSERT_EQ((std::vector<std::string>{ "bbb" }), to_vector(list));
+  // Bad removes
+  err = list.remove_node(list.head(), 1);
+  ASSERT_EQ(err, LINKEDLIST_ERR_BAD) << " : " << err;
+  auto other_list = UnrolledLinkedList<std::string, 2>();
+  err = other_list.insert_at_head("bunnyfoofoo");
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = list.remove_node(other_list.head(), 0);
+  ASSERT_EQ(err, LINKEDLIST_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  err = list.remove_head();
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_TRUE(list.empty());
+  err = list.remove_head_and_return(torn_value);
+  ASSERT_EQ(err, LINKEDLIST_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+}
+
+TEST(UnrolledLinkedListTests, TestFunctional_find_remove_copy)
+{
+  auto pool = UnrolledLinkedListNodePool<int, 4>();
+  auto list = UnrolledLinkedList<int, 4>(&pool);
+  for (int i = 0; i < 10; i++) {
+    auto err = list.insert_at_head(i);
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(3, list.num_nodes());
+  // Find things
+  auto* found = list.find_if([](int value) { return value == 5; });
+  ASSERT_NE(nullptr, found);
+  ASSERT_EQ(5, *found);
+  found = list.find_if([](int value) { return value == 100; });
+  ASSERT_EQ(nullptr, found);
+  // Remove things from the middle of a node; the order stays the same
+  auto err = list.remove_first_if([](int value) { return value == 5; });
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = list.remove_first_if([](int value) { return value == 100; });
+  ASSERT_EQ(err, LINKEDLIST_ERR_ELEMENT_NOT_FOUND) << " : " << err;
+  ASSERT_EQ((std::vector<int>{ 9, 8, 7, 6, 4, 3, 2, 1, 0 }), to_vector(list));
+  // Copies come out the same
+  auto copy = UnrolledLinkedList<int, 4>(&pool);
+  err = copy.insert_at_head(100);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  err = copy.copy_from(list);
+  ASSERT_EQ(err, ERR_OK) << " : " << err;
+  ASSERT_EQ(9, copy.size());
+  ASSERT_EQ(list.num_nodes(), copy.num_nodes());
+  ASSERT_EQ(to_vector(list), to_vector(copy));
+  // Clearing gives the nodes back to the pool
+  const size_t num_free = pool.num_free();
+  copy.clear();
+  ASSERT_TRUE(copy.empty());
+  ASSERT_EQ(num_free + list.num_nodes(), pool.num_free());
+}
+
+TEST(UnrolledLinkedListTests, TestFunctional_merge_nodes)
+{
+  // Fill 100 nodes, then remove 7 out of every 8 values all over the list
+  auto list = UnrolledLinkedList<std::string, 8>();
+  for (int i = 0; i < 800; i++) {
+    auto err = list.insert_at_head(std::to_string(i));
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(100, list.num_nodes());
+  for (int i = 0; i < 800; i++) {
+    if (i % 8 == 0) {
+      continue;
+    }
+    auto err = list.remove_first_if(
+      [i](const std::string& value) { return value == std::to_string(i); });
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  // Nodes got merged as they emptied out: every node but the last is at
+  // least half full, instead of 100 nodes holding one value each
+  ASSERT_EQ(100, list.size());
+  ASSERT_LE(list.num_nodes(), 100 / 4 + 1);
+  // ...and the order is the same
+  std::vector<std::string> expected;
+  for (int i = 792; i >= 0; i -= 8) {
+    expected.push_back(std::to_string(i));
+  }
+  ASSERT_EQ(expected, to_vector(list));
+  // Removing the rest empties it out completely
+  while (!list.empty()) {
+    auto err = list.remove_head();
+    ASSERT_EQ(err, ERR_OK) << " : " << err;
+  }
+  ASSERT_EQ(0, list.num_nodes());
+}
+
+auto
+main(int argc, char** argv) -> int
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}